@@ -0,0 +1,113 @@
+#include "../include/disk_database.h"
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <filesystem>
+#include <fcntl.h>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// searchByCuisine against a cold page cache, compared with reading the same results one getRestaurant at a
+// time in index order. The stream storage mode and a zero record cache make every record come from the file.
+
+static const char* CUISINES[] = {"Italian", "Thai", "Mexican", "Japanese", "Indian", "French", "Greek", "Korean"};
+static const char* LOCATIONS[] = {"Downtown", "Uptown", "Harbor", "Old Town", "Midtown", "Airport"};
+static const char* WORDS[] = {"great", "service", "slow", "friendly", "staff", "pasta", "amazing", "noodles", "spicy", "salty", "ambience", "parking", "portion", "price", "dessert", "noisy"};
+
+// Writes back and evicts the data file's pages, so the next reads go to the disk.
+static bool dropFromPageCache(const string& path) {
+#if defined(POSIX_FADV_DONTNEED) && !defined(_WIN32)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    fdatasync(fd);
+    bool dropped = posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+    ::close(fd);
+    return dropped;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+static vector<Restaurant> makeRestaurants(int count) {
+    mt19937 rng(14);
+    vector<Restaurant> restaurants;
+    for (int i = 0; i < count; i++) {
+        Restaurant r;
+        r.name = "Place " + to_string(i);
+        r.location = LOCATIONS[rng() % 6];
+        r.cuisineTypes.push_back(CUISINES[rng() % 8]);
+        r.overallRating = (rng() % 50) / 10.0f;
+        r.averagePrice = 5 + rng() % 60;
+        int words = 20 + rng() % 40;
+        for (int w = 0; w < words; w++) {
+            r.notes += WORDS[rng() % 16];
+            r.notes += ' ';
+        }
+        restaurants.push_back(r);
+    }
+    return restaurants;
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? atoi(argv[1]) : 50000;
+    string path = argc > 2 ? argv[2] : "cold_search_benchmark.dat";
+    
+    for (const char* suffix : {"", ".idx", ".cols"}) {
+        filesystem::remove(path + suffix);
+    }
+    
+    {
+        DiskDatabase db(path, STORAGE_STREAM);
+        vector<Restaurant> restaurants = makeRestaurants(count);
+        for (size_t i = 0; i < restaurants.size(); i += 1000) {
+            vector<Restaurant> batch(restaurants.begin() + i, restaurants.begin() + min(restaurants.size(), i + 1000));
+            db.addRestaurants(batch);
+        }
+    }
+    
+    DiskDatabase db(path, STORAGE_STREAM);
+    db.setCacheCapacity(0);
+    db.searchByCuisine(CUISINES[0]);
+    
+    bool cold = dropFromPageCache(path);
+    double searchMs = 0;
+    vector<vector<string>> results;
+    for (const char* cuisine : CUISINES) {
+        dropFromPageCache(path);
+        auto start = chrono::steady_clock::now();
+        vector<Restaurant> found = db.searchByCuisine(cuisine);
+        searchMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    
+        results.push_back(vector<string>());
+        for (const auto& r : found) {
+            results.back().push_back(r.restaurantId);
+        }
+    }
+    
+    double pointMs = 0;
+    size_t records = 0;
+    for (const auto& ids : results) {
+        dropFromPageCache(path);
+        auto start = chrono::steady_clock::now();
+        for (const auto& id : ids) {
+            db.getRestaurant(id);
+        }
+        pointMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        records += ids.size();
+    }
+    
+    cout << "Records: " << count << ", data file " << filesystem::file_size(path) << " bytes" << endl;
+    if (!cold) {
+        cout << "Page cache could not be dropped, timings are warm" << endl;
+    }
+    cout << "searchByCuisine, coalesced reads: " << searchMs << " ms for " << records << " records" << endl;
+    cout << "getRestaurant per result:         " << pointMs << " ms for " << records << " records" << endl;
+    return 0;
+}
@@ -0,0 +1,128 @@
+#include "../include/disk_database.h"
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <filesystem>
+
+using namespace std;
+
+// Data file size and read latency with and without COMPRESSION_BLOCKS, on restaurants whose notes and dish
+// lists dominate the bytes. Every record read from the compressed file is also checked against the plain one.
+
+static const char* CUISINES[] = {"Italian", "Thai", "Mexican", "Japanese", "Indian", "French", "Greek", "Korean"};
+static const char* LOCATIONS[] = {"Downtown", "Uptown", "Harbor", "Old Town", "Midtown", "Airport"};
+static const char* DISHES[] = {"Margherita Pizza", "Pad Thai", "Green Curry", "Tacos al Pastor", "Ramen", "Butter Chicken", "Sushi Platter", "Bibimbap"};
+static const char* WORDS[] = {"great", "service", "slow", "friendly", "staff", "pasta", "amazing", "noodles", "spicy", "salty", "ambience", "parking", "portion", "price", "dessert", "noisy"};
+
+struct FileResult {
+    uintmax_t bytes;
+    double pointReadUs;
+    double cuisineSearchMs;
+    vector<Restaurant> records;
+};
+
+static vector<Restaurant> makeRestaurants(int count) {
+    mt19937 rng(20);
+    vector<Restaurant> restaurants;
+    for (int i = 0; i < count; i++) {
+        Restaurant r;
+        r.name = "Place " + to_string(i);
+        r.location = LOCATIONS[rng() % 6];
+        r.cuisineTypes.push_back(CUISINES[rng() % 8]);
+        r.overallRating = (rng() % 50) / 10.0f;
+        r.averagePrice = 5 + rng() % 60;
+        int words = 10 + rng() % 40;
+        for (int w = 0; w < words; w++) {
+            r.notes += WORDS[rng() % 16];
+            r.notes += ' ';
+        }
+        int dishes = 2 + rng() % 6;
+        for (int d = 0; d < dishes; d++) {
+            r.dishes.push_back(Dish(DISHES[rng() % 8], (rng() % 50) / 10.0f, 5 + rng() % 30));
+        }
+        restaurants.push_back(r);
+    }
+    return restaurants;
+}
+
+static FileResult measure(const string& path, CompressionMode compression, const vector<Restaurant>& restaurants, int reads) {
+    for (const char* suffix : {"", ".idx", ".cols"}) {
+        filesystem::remove(path + suffix);
+    }
+    
+    vector<string> ids;
+    {
+        DiskDatabase db(path, STORAGE_MMAP);
+        db.setCompression(compression);
+        for (size_t i = 0; i < restaurants.size(); i += 1000) {
+            vector<Restaurant> batch(restaurants.begin() + i, restaurants.begin() + min(restaurants.size(), i + 1000));
+            vector<string> added = db.addRestaurants(batch);
+            ids.insert(ids.end(), added.begin(), added.end());
+        }
+    }
+    
+    FileResult result;
+    result.bytes = filesystem::file_size(path);
+    
+    DiskDatabase db(path, STORAGE_MMAP);
+    db.setCacheCapacity(0);
+    for (const auto& id : ids) {
+        result.records.push_back(db.getRestaurant(id));
+    }
+    
+    mt19937 rng(7);
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < reads; i++) {
+        db.getRestaurant(ids[rng() % ids.size()]);
+    }
+    result.pointReadUs = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / reads;
+    
+    start = chrono::steady_clock::now();
+    for (const char* cuisine : CUISINES) {
+        db.searchByCuisine(cuisine);
+    }
+    result.cuisineSearchMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    
+    return result;
+}
+
+static bool sameRestaurant(const Restaurant& a, const Restaurant& b) {
+    if (a.restaurantId != b.restaurantId || a.name != b.name || a.location != b.location || a.cuisineTypes != b.cuisineTypes ||
+        a.overallRating != b.overallRating || a.averagePrice != b.averagePrice || a.notes != b.notes || a.dishes.size() != b.dishes.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.dishes.size(); i++) {
+        if (a.dishes[i].dishName != b.dishes[i].dishName || a.dishes[i].rating != b.dishes[i].rating || a.dishes[i].price != b.dishes[i].price) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int count = argc > 1 ? atoi(argv[1]) : 50000;
+    string path = argc > 2 ? argv[2] : "compression_benchmark";
+    int reads = 20000;
+    
+    vector<Restaurant> restaurants = makeRestaurants(count);
+    FileResult plain = measure(path + "_plain.dat", COMPRESSION_NONE, restaurants, reads);
+    FileResult compressed = measure(path + "_blocks.dat", COMPRESSION_BLOCKS, restaurants, reads);
+    
+    int mismatches = 0;
+    for (size_t i = 0; i < plain.records.size(); i++) {
+        if (!sameRestaurant(plain.records[i], compressed.records[i])) {
+            mismatches++;
+        }
+    }
+    
+    cout << "Records: " << count << endl;
+    cout << "plain:      " << plain.bytes << " bytes, point read " << plain.pointReadUs << " us, all cuisine searches " << plain.cuisineSearchMs << " ms" << endl;
+    cout << "compressed: " << compressed.bytes << " bytes, point read " << compressed.pointReadUs << " us, all cuisine searches " << compressed.cuisineSearchMs << " ms" << endl;
+    cout << "Size reduction: " << (100.0 - 100.0 * compressed.bytes / plain.bytes) << "%" << endl;
+    
+    if (mismatches > 0) {
+        cerr << "Error. " << mismatches << " compressed records differ from the plain file" << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "../include/btree.h"
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <map>
+
+using namespace std;
+
+// Rating-range queries on the BPlusTree used by the rating index, against std::multimap as the ordered-map
+// baseline. Keys are ratings in steps of 0.1 with many offsets per rating, as in ratingIndex.
+
+struct RangeTiming {
+    double insertMs;
+    double queryUs[3];
+    long long results[3];
+};
+
+static const float WIDTHS[] = {0.05f, 0.5f, 2.0f};
+
+static float randomRating(mt19937& rng) {
+    return (rng() % 50) / 10.0f;
+}
+
+template <typename Index, typename Insert, typename Query>
+static RangeTiming measure(Index& index, int entries, Insert insert, Query query) {
+    RangeTiming timing;
+    mt19937 rng(42);
+    
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < entries; i++) {
+        insert(index, randomRating(rng), (long long)i * 120);
+    }
+    timing.insertMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    
+    for (int w = 0; w < 3; w++) {
+        mt19937 queries(7);
+        int repeats = WIDTHS[w] < 0.1f ? 2000 : 200;
+        long long total = 0;
+        start = chrono::steady_clock::now();
+        for (int r = 0; r < repeats; r++) {
+            float low = randomRating(queries);
+            total += query(index, low, low + WIDTHS[w]);
+        }
+        timing.queryUs[w] = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / repeats;
+        timing.results[w] = total / repeats;
+    }
+    return timing;
+}
+
+static void report(const char* name, const RangeTiming& timing) {
+    cout << name << " insert " << timing.insertMs << " ms" << endl;
+    for (int w = 0; w < 3; w++) {
+        cout << "  width " << WIDTHS[w] << ": " << timing.queryUs[w] << " us/query, " << timing.results[w] << " results" << endl;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int entries = argc > 1 ? atoi(argv[1]) : 1000000;
+    
+    BPlusTree<float, long long> tree;
+    RangeTiming bplus = measure(tree, entries,
+        [](BPlusTree<float, long long>& index, float key, long long value) { index.insert(key, value); },
+        [](BPlusTree<float, long long>& index, float low, float high) { return (long long)index.searchRange(low, high).size(); });
+    
+    multimap<float, long long> ordered;
+    RangeTiming baseline = measure(ordered, entries,
+        [](multimap<float, long long>& index, float key, long long value) { index.insert(make_pair(key, value)); },
+        [](multimap<float, long long>& index, float low, float high) {
+            vector<long long> values;
+            for (auto it = index.lower_bound(low); it != index.end() && it->first <= high; ++it) {
+                values.push_back(it->second);
+            }
+            return (long long)values.size();
+        });
+    
+    cout << "Entries: " << entries << endl;
+    report("BPlusTree", bplus);
+    report("std::multimap", baseline);
+    return 0;
+}
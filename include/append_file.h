@@ -0,0 +1,33 @@
+#ifndef APPEND_FILE_H
+#define APPEND_FILE_H
+
+#include <string>
+
+using namespace std;
+
+class AppendFile {
+private:
+    string path;
+    int fd;
+    long long size;
+    
+    void truncateTo(long long length);
+
+public:
+    AppendFile();
+    ~AppendFile();
+    
+    AppendFile(const AppendFile&) = delete;
+    AppendFile& operator=(const AppendFile&) = delete;
+    
+    bool open(const string& filepath);
+    void close();
+    
+    bool append(const char* data, size_t length);
+    bool sync();
+    
+    bool isOpen() const { return fd >= 0; }
+    long long getSize() const { return size; }
+};
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef BLOCK_INDEX_H
+#define BLOCK_INDEX_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+using namespace std;
+
+// Where the compressed blocks of a data file start and how many records each holds, in file order.
+// A record inside a block is addressed as the block's offset plus its slot.
+class BlockIndex {
+private:
+    vector<long long> starts;
+    vector<uint32_t> counts;
+    
+public:
+    // Blocks only ever arrive in file order, so replaying part of the file again is a no-op.
+    void add(long long offset, uint32_t records) {
+        if (!starts.empty() && offset <= starts.back()) {
+            return;
+        }
+        starts.push_back(offset);
+        counts.push_back(records);
+    }
+    
+    bool find(long long offset, long long& blockOffset, uint32_t& slot) const {
+        auto it = upper_bound(starts.begin(), starts.end(), offset);
+        if (it == starts.begin()) {
+            return false;
+        }
+        size_t i = it - starts.begin() - 1;
+        if (offset - starts[i] >= counts[i]) {
+            return false;
+        }
+        blockOffset = starts[i];
+        slot = offset - starts[i];
+        return true;
+    }
+    
+    bool contains(long long offset) const {
+        long long blockOffset;
+        uint32_t slot;
+        return find(offset, blockOffset, slot);
+    }
+    
+    void truncate(long long end) {
+        while (!starts.empty() && starts.back() >= end) {
+            starts.pop_back();
+            counts.pop_back();
+        }
+    }
+    
+    int size() const { return starts.size(); }
+    long long blockStart(int i) const { return starts[i]; }
+    uint32_t blockRecords(int i) const { return counts[i]; }
+    
+    void clear() {
+        starts.clear();
+        counts.clear();
+    }
+    
+    void swap(BlockIndex& other) {
+        starts.swap(other.starts);
+        counts.swap(other.counts);
+    }
+};
+
+#endif
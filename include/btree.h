@@ -4,224 +4,760 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <utility>
+#include <iterator>
+#include <type_traits>
+#include "node_pool.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define BTREE_X86
+#include <immintrin.h>
+#endif
 
 using namespace std;
 
+template <typename K>
+struct KeyStats {
+    int count;
+    double sum;
+    K min;
+    K max;
+    
+    KeyStats() : count(0), sum(0), min(), max() {}
+    
+    void add(K key) {
+        if (count == 0 || key < min) min = key;
+        if (count == 0 || key > max) max = key;
+        count++;
+        sum += key;
+    }
+    
+    void merge(const KeyStats& other) {
+        if (other.count == 0) return;
+        if (count == 0 || other.min < min) min = other.min;
+        if (count == 0 || other.max > max) max = other.max;
+        count += other.count;
+        sum += other.sum;
+    }
+    
+    double average() const {
+        return count > 0 ? sum / count : 0.0;
+    }
+};
+
+// Entries are ordered by key, then value, so one entry among many duplicates is found in O(log n).
 template <typename K, typename V>
-class BTreeNode {
-public:
-    vector<K> keys; 
-    vector<V> values;
-    vector<BTreeNode*> children;
-    bool leaf; 
-    int t;
+inline bool entryBefore(const K& k1, const V& v1, const K& k2, const V& v2) {
+    return k1 < k2 || (!(k2 < k1) && v1 < v2);
+}
+
+// Node search for the B+tree: keys are sorted, so the lower bound is the number of keys below the probe.
+template <typename K>
+inline int countBelow(const K* keys, int n, K key) {
+    if (n == 0) {
+        return 0;
+    }
+    
+    const K* base = keys;
+    while (n > 1) {
+        int half = n / 2;
+        base = base[half] < key ? base + half : base;
+        n -= half;
+    }
+    return (base - keys) + (*base < key);
+}
+
+#ifdef BTREE_X86
+// Four float keys per compare; a node's keys fit in a few instructions with no branches on the data.
+template <>
+inline int countBelow<float>(const float* keys, int n, float key) {
+    __m128 probe = _mm_set1_ps(key);
+    int below = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        unsigned mask = _mm_movemask_ps(_mm_cmplt_ps(_mm_loadu_ps(keys + i), probe));
+        below += (mask & 1) + ((mask >> 1) & 1) + ((mask >> 2) & 1) + (mask >> 3);
+    }
+    for (; i < n; i++) {
+        below += keys[i] < key;
+    }
+    return below;
+}
+#endif
+
+// Up to 2 * 16 float keys per node: two 64-byte cache lines, compared four at a time.
+const int BPLUS_DEGREE = 16;
 
-    BTreeNode(int _t, bool _leaf);
-    ~BTreeNode();
+// Share of each node bulkLoad fills, leaving room for later inserts before the first splits.
+const double BPLUS_FILL_FACTOR = 0.9;
 
-    void insertNonFull(K key, V value);
-    void splitChild(int i, BTreeNode* y);
+// B+tree variant: entries live only in leaves, which are chained in order, and interior nodes hold a copy
+// of the first entry of every child after the first. A range query is one descent plus a walk along the
+// leaves. Each (key, value) entry is stored once.
+//
+// Nodes are fixed-size: a leaf is the header line followed by the key array and the value array, and an
+// interior node appends its child pointers. Each holds up to 2T - 1 entries plus one taken just before a split.
+template <typename K, typename V, int T>
+struct BPlusNode {
+    static const int CAPACITY = 2 * T;
     
-    V* search(K key);
-    void searchRange(K minKey, K maxKey, vector<V>& results);
+    int count;
+    bool leaf;
+    KeyStats<K> stats;
+    BPlusNode* prev;
+    BPlusNode* next;
+    alignas(64) K keys[CAPACITY];
+    V values[CAPACITY];
     
-    void traverse();
+    BPlusNode(bool _leaf) : count(0), leaf(_leaf), prev(nullptr), next(nullptr) {}
+    
+    int lowerBound(K key) const {
+        return countBelow(keys, count, key);
+    }
+    
+    // Duplicates of a key are then told apart by a binary search on their values.
+    int lowerBound(K key, V value) const {
+        int lo = lowerBound(key);
+        int hi = count;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (entryBefore(keys[mid], values[mid], key, value)) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+    
+    // An entry equal to a separator lives in the child to its right.
+    int upperBound(K key, V value) const {
+        int lo = lowerBound(key);
+        int hi = count;
+        while (lo < hi) {
+            int mid = (lo + hi) / 2;
+            if (entryBefore(key, value, keys[mid], values[mid])) {
+                hi = mid;
+            } else {
+                lo = mid + 1;
+            }
+        }
+        return lo;
+    }
+    
+    void insertAt(int i, K key, V value) {
+        copy_backward(keys + i, keys + count, keys + count + 1);
+        copy_backward(values + i, values + count, values + count + 1);
+        keys[i] = key;
+        values[i] = value;
+        count++;
+    }
+    
+    void eraseAt(int i) {
+        copy(keys + i + 1, keys + count, keys + i);
+        copy(values + i + 1, values + count, values + i);
+        count--;
+    }
 };
 
-template <typename K, typename V>
-class BTree {
-private:
-    BTreeNode<K, V>* root;
-    int t;
+// Child slots are maintained after the separators: insertChild follows insertAt and eraseChild follows eraseAt.
+template <typename K, typename V, int T>
+struct BPlusInterior : BPlusNode<K, V, T> {
+    BPlusNode<K, V, T>* children[2 * T + 1];
+    
+    BPlusInterior() : BPlusNode<K, V, T>(false) {}
+    
+    void insertChild(int i, BPlusNode<K, V, T>* child) {
+        copy_backward(children + i, children + this->count, children + this->count + 1);
+        children[i] = child;
+    }
+    
+    void eraseChild(int i) {
+        copy(children + i + 1, children + this->count + 2, children + i);
+    }
+};
 
-public:
-    BTree(int _t);
-    ~BTree();
+struct TreeMemoryStats {
+    NodePoolStats leaves;
+    NodePoolStats interiors;
+    int entries;
+    
+    TreeMemoryStats() : entries(0) {}
+    
+    long long nodeAllocations() const { return leaves.allocations + interiors.allocations; }
+    int liveNodes() const { return leaves.liveNodes + interiors.liveNodes; }
+    size_t liveBytes() const { return leaves.liveBytes + interiors.liveBytes; }
+    size_t reservedBytes() const { return leaves.reservedBytes + interiors.reservedBytes; }
+    
+    double bytesPerEntry() const {
+        return entries > 0 ? (double)reservedBytes() / entries : 0.0;
+    }
+};
 
+template <typename K, typename V, int T = BPLUS_DEGREE>
+class BPlusTree {
+private:
+    static_assert(T >= 2, "a B+tree needs a degree of at least 2");
+    
+    typedef BPlusNode<K, V, T> Node;
+    typedef BPlusInterior<K, V, T> Interior;
+    
+    Node* root;
+    NodePool<Node> leafPool;
+    NodePool<Interior> interiorPool;
+    
+    static Interior* interior(Node* node) { return static_cast<Interior*>(node); }
+    static const Interior* interior(const Node* node) { return static_cast<const Interior*>(node); }
+    
+    Node* newLeaf();
+    Interior* newInterior();
+    void release(Node* node);
+    void destroy(Node* node);
+    
+    Node* firstLeaf() const;
+    Node* lastLeaf() const;
+    Node* leafFor(K key, int& i) const;
+    
+    bool insertInto(Node* node, K key, V value);
+    bool removeFrom(Node* node, K key, V value);
+    void splitChild(Interior* parent, int i);
+    void fill(Interior* parent, int i);
+    void borrowFromPrev(Interior* parent, int i);
+    void borrowFromNext(Interior* parent, int i);
+    void merge(Interior* parent, int i);
+    void recount(Node* node);
+    static int nodesFor(int items, int perNode, int minPerNode);
+    void aggregate(const Node* node, K minKey, K maxKey, bool coveredLow, bool coveredHigh, KeyStats<K>& result) const;
+    
+public:
+    BPlusTree();
+    ~BPlusTree();
+    
+    BPlusTree(const BPlusTree&) = delete;
+    BPlusTree& operator=(const BPlusTree&) = delete;
+    
     void insert(K key, V value);
+    bool remove(K key, V value);
+    bool update(K key, V oldValue, V newValue);
     V* search(K key);
     vector<V> searchRange(K minKey, K maxKey);
+    vector<pair<K, V>> getAllPairs();
+    KeyStats<K> getStats() const { return root->stats; }
+    KeyStats<K> rangeStats(K minKey, K maxKey);
+    TreeMemoryStats getMemoryStats() const;
+    
+    // Replaces the contents with [first, last), which must be (key, value) pairs in ascending order without repeats.
+    template <typename It> void bulkLoad(It first, It last, double fillFactor = BPLUS_FILL_FACTOR);
+    
+    // visit(key, value) returns false to stop the walk early.
+    template <typename F> void forEachAscending(F visit);
+    template <typename F> void forEachDescending(F visit);
     void traverse();
-    void clear(BTreeNode<K, V>* node);
+    void clear();
+    void swap(BPlusTree& other);
 };
 
 
-template <typename K, typename V>
-BTreeNode<K, V>::BTreeNode(int _t, bool _leaf) : t(_t), leaf(_leaf) {}
+template <typename K, typename V, int T>
+BPlusTree<K, V, T>::BPlusTree() {
+    root = newLeaf();
+}
 
-template <typename K, typename V>
-BTreeNode<K, V>::~BTreeNode() {
-    for (auto child : children) {
-        delete child;
+// The pools free their slabs in bulk; nodes are only walked when their keys or values need destructors.
+template <typename K, typename V, int T>
+BPlusTree<K, V, T>::~BPlusTree() {
+    if (!is_trivially_destructible<Interior>::value) {
+        destroy(root);
     }
 }
 
-template <typename K, typename V>
-void BTreeNode<K, V>::insertNonFull(K key, V value) {
-    int i = keys.size() - 1;
-
-    if (leaf) {
-        keys.push_back(K());
-        values.push_back(V());
-        
-        while (i >= 0 && keys[i] > key) {
-            keys[i + 1] = keys[i];
-            values[i + 1] = values[i];
-            i--;
-        }
-        
-        keys[i + 1] = key;
-        values[i + 1] = value;
+template <typename K, typename V, int T>
+BPlusNode<K, V, T>* BPlusTree<K, V, T>::newLeaf() {
+    return new (leafPool.allocate()) Node(true);
+}
+
+template <typename K, typename V, int T>
+BPlusInterior<K, V, T>* BPlusTree<K, V, T>::newInterior() {
+    return new (interiorPool.allocate()) Interior();
+}
+
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::release(Node* node) {
+    if (node->leaf) {
+        node->~Node();
+        leafPool.release(node);
     } else {
-        while (i >= 0 && keys[i] > key) {
-            i--;
-        }
-        i++;
-        
-        if (children[i]->keys.size() == 2 * t - 1) {
-            splitChild(i, children[i]);
-            
-            if (keys[i] < key) {
-                i++;
-            }
+        Interior* parent = interior(node);
+        parent->~Interior();
+        interiorPool.release(parent);
+    }
+}
+
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::destroy(Node* node) {
+    if (!node->leaf) {
+        for (int i = 0; i <= node->count; i++) {
+            destroy(interior(node)->children[i]);
         }
-        children[i]->insertNonFull(key, value);
     }
+    release(node);
 }
 
-template <typename K, typename V>
-void BTreeNode<K, V>::splitChild(int i, BTreeNode* y) {
-    BTreeNode* z = new BTreeNode(y->t, y->leaf);
-    
-    int mid = t - 1;
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::clear() {
+    if (!is_trivially_destructible<Interior>::value) {
+        destroy(root);
+    }
+    leafPool.clear();
+    interiorPool.clear();
+    root = newLeaf();
+}
+
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::swap(BPlusTree& other) {
+    std::swap(root, other.root);
+    leafPool.swap(other.leafPool);
+    interiorPool.swap(other.interiorPool);
+}
+
+template <typename K, typename V, int T>
+TreeMemoryStats BPlusTree<K, V, T>::getMemoryStats() const {
+    TreeMemoryStats stats;
+    stats.leaves = leafPool.getStats();
+    stats.interiors = interiorPool.getStats();
+    stats.entries = root->stats.count;
+    return stats;
+}
+
+template <typename K, typename V, int T>
+BPlusNode<K, V, T>* BPlusTree<K, V, T>::firstLeaf() const {
+    Node* node = root;
+    while (!node->leaf) {
+        node = interior(node)->children[0];
+    }
+    return node;
+}
+
+template <typename K, typename V, int T>
+BPlusNode<K, V, T>* BPlusTree<K, V, T>::lastLeaf() const {
+    Node* node = root;
+    while (!node->leaf) {
+        node = interior(node)->children[node->count];
+    }
+    return node;
+}
+
+// Leaf and position of the first entry whose key is not below key; the position may be one past the leaf's end.
+template <typename K, typename V, int T>
+BPlusNode<K, V, T>* BPlusTree<K, V, T>::leafFor(K key, int& i) const {
+    Node* node = root;
+    while (!node->leaf) {
+        node = interior(node)->children[node->lowerBound(key)];
+    }
+    i = node->lowerBound(key);
+    return node;
+}
+
+// Nodes are split after the insert that overfills them.
+template <typename K, typename V, int T>
+bool BPlusTree<K, V, T>::insertInto(Node* node, K key, V value) {
+    if (node->leaf) {
+        int i = node->lowerBound(key, value);
+        if (i < node->count && node->keys[i] == key && node->values[i] == value) {
+            return false;
+        }
+        node->insertAt(i, key, value);
+        node->stats.add(key);
+        return true;
+    }
     
-    for (int j = 0; j < t - 1; j++) {
-        z->keys.push_back(y->keys[mid + 1 + j]);
-        z->values.push_back(y->values[mid + 1 + j]);
+    Interior* parent = interior(node);
+    int i = node->upperBound(key, value);
+    if (!insertInto(parent->children[i], key, value)) {
+        return false;
     }
+    if (parent->children[i]->count > 2 * T - 1) {
+        splitChild(parent, i);
+    }
+    node->stats.add(key);
+    return true;
+}
+
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::splitChild(Interior* parent, int i) {
+    Node* left = parent->children[i];
+    Node* right;
+    int mid = left->count / 2;
     
-    if (!y->leaf) {
-        for (int j = 0; j < t; j++) {
-            z->children.push_back(y->children[mid + 1 + j]);
+    if (left->leaf) {
+        right = newLeaf();
+        copy(left->keys + mid, left->keys + left->count, right->keys);
+        copy(left->values + mid, left->values + left->count, right->values);
+        right->count = left->count - mid;
+    
+        right->next = left->next;
+        right->prev = left;
+        if (right->next) {
+            right->next->prev = right;
         }
-        y->children.resize(t);
+        left->next = right;
+        parent->insertAt(i, right->keys[0], right->values[0]);
+    } else {
+        Interior* split = newInterior();
+        copy(left->keys + mid + 1, left->keys + left->count, split->keys);
+        copy(left->values + mid + 1, left->values + left->count, split->values);
+        copy(interior(left)->children + mid + 1, interior(left)->children + left->count + 1, split->children);
+        split->count = left->count - mid - 1;
+        parent->insertAt(i, left->keys[mid], left->values[mid]);
+        right = split;
     }
     
-    keys.insert(keys.begin() + i, y->keys[mid]);
-    values.insert(values.begin() + i, y->values[mid]);
-    
-    children.insert(children.begin() + i + 1, z);
+    left->count = mid;
+    parent->insertChild(i + 1, right);
+    recount(left);
+    recount(right);
+}
+
+// Separators are only routing bounds, so removing a leaf's first entry leaves its separator in place.
+template <typename K, typename V, int T>
+bool BPlusTree<K, V, T>::removeFrom(Node* node, K key, V value) {
+    if (node->leaf) {
+        int i = node->lowerBound(key, value);
+        if (i == node->count || node->keys[i] != key || node->values[i] != value) {
+            return false;
+        }
+        node->eraseAt(i);
+        recount(node);
+        return true;
+    }
     
-    y->keys.resize(mid);
-    y->values.resize(mid);
+    Interior* parent = interior(node);
+    int i = node->upperBound(key, value);
+    if (!removeFrom(parent->children[i], key, value)) {
+        return false;
+    }
+    if (parent->children[i]->count < T - 1) {
+        fill(parent, i);
+    }
+    recount(node);
+    return true;
 }
 
-template <typename K, typename V>
-V* BTreeNode<K, V>::search(K key) {
-    int i = 0;
-    while (i < keys.size() && key > keys[i]) {
-        i++;
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::fill(Interior* parent, int i) {
+    if (i > 0 && parent->children[i - 1]->count > T - 1) {
+        borrowFromPrev(parent, i);
+    } else if (i < parent->count && parent->children[i + 1]->count > T - 1) {
+        borrowFromNext(parent, i);
+    } else if (i < parent->count) {
+        merge(parent, i);
+    } else {
+        merge(parent, i - 1);
     }
+}
+
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::borrowFromPrev(Interior* parent, int i) {
+    Node* child = parent->children[i];
+    Node* sibling = parent->children[i - 1];
+    int last = sibling->count - 1;
     
-    if (i < keys.size() && keys[i] == key) {
-        return &values[i];
+    if (child->leaf) {
+        child->insertAt(0, sibling->keys[last], sibling->values[last]);
+        parent->keys[i - 1] = child->keys[0];
+        parent->values[i - 1] = child->values[0];
+    } else {
+        child->insertAt(0, parent->keys[i - 1], parent->values[i - 1]);
+        interior(child)->insertChild(0, interior(sibling)->children[sibling->count]);
+        parent->keys[i - 1] = sibling->keys[last];
+        parent->values[i - 1] = sibling->values[last];
     }
     
-    if (leaf) {
-        return nullptr;
+    sibling->count--;
+    recount(child);
+    recount(sibling);
+}
+
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::borrowFromNext(Interior* parent, int i) {
+    Node* child = parent->children[i];
+    Node* sibling = parent->children[i + 1];
+    
+    if (child->leaf) {
+        child->insertAt(child->count, sibling->keys[0], sibling->values[0]);
+        sibling->eraseAt(0);
+        parent->keys[i] = sibling->keys[0];
+        parent->values[i] = sibling->values[0];
+    } else {
+        child->insertAt(child->count, parent->keys[i], parent->values[i]);
+        interior(child)->children[child->count] = interior(sibling)->children[0];
+        parent->keys[i] = sibling->keys[0];
+        parent->values[i] = sibling->values[0];
+        sibling->eraseAt(0);
+        interior(sibling)->eraseChild(0);
     }
     
-    return children[i]->search(key);
+    recount(child);
+    recount(sibling);
 }
 
-template <typename K, typename V>
-void BTreeNode<K, V>::searchRange(K minKey, K maxKey, vector<V>& results) {
-    int i = 0;
+// Appends children[i + 1] to children[i]; interior nodes also pull the separator between them down.
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::merge(Interior* parent, int i) {
+    Node* left = parent->children[i];
+    Node* right = parent->children[i + 1];
     
-    while (i < keys.size() && keys[i] < minKey) {
-        i++;
+    if (left->leaf) {
+        left->next = right->next;
+        if (left->next) {
+            left->next->prev = left;
+        }
+    } else {
+        left->insertAt(left->count, parent->keys[i], parent->values[i]);
+        copy(interior(right)->children, interior(right)->children + right->count + 1, interior(left)->children + left->count);
     }
+    copy(right->keys, right->keys + right->count, left->keys + left->count);
+    copy(right->values, right->values + right->count, left->values + left->count);
+    left->count += right->count;
     
-    while (i < keys.size() && keys[i] <= maxKey) {
-        if (keys[i] >= minKey) {
-            results.push_back(values[i]);
+    parent->eraseAt(i);
+    parent->eraseChild(i + 1);
+    release(right);
+    recount(left);
+}
+
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::recount(Node* node) {
+    node->stats = KeyStats<K>();
+    if (node->leaf) {
+        for (int i = 0; i < node->count; i++) {
+            node->stats.add(node->keys[i]);
         }
-        
-        if (!leaf) {
-            children[i]->searchRange(minKey, maxKey, results);
+        return;
+    }
+    for (int i = 0; i <= node->count; i++) {
+        node->stats.merge(interior(node)->children[i]->stats);
+    }
+}
+
+// How many nodes to spread items over so each gets about perNode and none gets fewer than minPerNode.
+template <typename K, typename V, int T>
+int BPlusTree<K, V, T>::nodesFor(int items, int perNode, int minPerNode) {
+    int nodes = (items + perNode - 1) / perNode;
+    return max(1, min(nodes, items / minPerNode));
+}
+
+// Builds bottom-up: leaves are filled in order and chained, then each level of interior nodes takes the
+// first entry under every child but the first as its separators, until one node is left as the root.
+template <typename K, typename V, int T>
+template <typename It>
+void BPlusTree<K, V, T>::bulkLoad(It first, It last, double fillFactor) {
+    clear();
+    int n = distance(first, last);
+    if (n == 0) {
+        return;
+    }
+    
+    int perLeaf = max(T - 1, min(2 * T - 1, (int)(fillFactor * (2 * T - 1))));
+    int leafCount = nodesFor(n, perLeaf, T - 1);
+    
+    vector<Node*> level;
+    vector<pair<K, V>> firsts;
+    level.reserve(leafCount);
+    firsts.reserve(leafCount);
+    
+    Node* prev = nullptr;
+    for (int i = 0; i < leafCount; i++) {
+        Node* leaf = i == 0 ? root : newLeaf();
+        int take = n / leafCount + (i < n % leafCount);
+        for (int j = 0; j < take; j++, ++first) {
+            leaf->keys[j] = first->first;
+            leaf->values[j] = first->second;
+        }
+        leaf->count = take;
+    
+        leaf->prev = prev;
+        if (prev) {
+            prev->next = leaf;
         }
-        i++;
+        prev = leaf;
+    
+        recount(leaf);
+        level.push_back(leaf);
+        firsts.push_back(make_pair(leaf->keys[0], leaf->values[0]));
     }
     
-    if (!leaf && i < children.size()) {
-        children[i]->searchRange(minKey, maxKey, results);
+    int perInterior = max(T, min(2 * T, (int)(fillFactor * 2 * T)));
+    while (level.size() > 1) {
+        int m = level.size();
+        int parents = nodesFor(m, perInterior, T);
+        vector<Node*> upper;
+        vector<pair<K, V>> upperFirsts;
+        upper.reserve(parents);
+        upperFirsts.reserve(parents);
+    
+        int child = 0;
+        for (int i = 0; i < parents; i++) {
+            Interior* parent = newInterior();
+            int take = m / parents + (i < m % parents);
+            upperFirsts.push_back(firsts[child]);
+            for (int j = 0; j < take; j++, child++) {
+                parent->children[j] = level[child];
+                if (j > 0) {
+                    parent->keys[j - 1] = firsts[child].first;
+                    parent->values[j - 1] = firsts[child].second;
+                }
+            }
+            parent->count = take - 1;
+            recount(parent);
+            upper.push_back(parent);
+        }
+    
+        level.swap(upper);
+        firsts.swap(upperFirsts);
     }
+    root = level[0];
 }
 
-template <typename K, typename V>
-void BTreeNode<K, V>::traverse() {
-    int i;
-    for (i = 0; i < keys.size(); i++) {
-        if (!leaf) {
-            children[i]->traverse();
+// Child i holds keys between separators i - 1 and i, both inclusive, since duplicates of a key can straddle one.
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::aggregate(const Node* node, K minKey, K maxKey, bool coveredLow, bool coveredHigh, KeyStats<K>& result) const {
+    if (coveredLow && coveredHigh) {
+        result.merge(node->stats);
+        return;
+    }
+    
+    if (node->leaf) {
+        for (int i = node->lowerBound(minKey); i < node->count && node->keys[i] <= maxKey; i++) {
+            result.add(node->keys[i]);
         }
-        cout << keys[i] << " ";
+        return;
     }
     
-    if (!leaf) {
-        children[i]->traverse();
+    int n = node->count;
+    for (int i = node->lowerBound(minKey); i <= n; i++) {
+        if (i > 0 && node->keys[i - 1] > maxKey) {
+            break;
+        }
+        bool childLow = i == 0 ? coveredLow : node->keys[i - 1] >= minKey;
+        bool childHigh = i == n ? coveredHigh : node->keys[i] <= maxKey;
+        aggregate(interior(node)->children[i], minKey, maxKey, childLow, childHigh, result);
     }
 }
 
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::insert(K key, V value) {
+    if (!insertInto(root, key, value) || root->count <= 2 * T - 1) {
+        return;
+    }
+    
+    Interior* s = newInterior();
+    s->children[0] = root;
+    splitChild(s, 0);
+    recount(s);
+    root = s;
+}
 
-template <typename K, typename V>
-BTree<K, V>::BTree(int _t) : t(_t) {
-    root = new BTreeNode<K, V>(t, true);
+template <typename K, typename V, int T>
+bool BPlusTree<K, V, T>::remove(K key, V value) {
+    bool removed = removeFrom(root, key, value);
+    
+    if (!root->leaf && root->count == 0) {
+        Node* old = root;
+        root = interior(old)->children[0];
+        release(old);
+    }
+    return removed;
 }
 
-template <typename K, typename V>
-BTree<K, V>::~BTree() {
-    clear(root);
+template <typename K, typename V, int T>
+bool BPlusTree<K, V, T>::update(K key, V oldValue, V newValue) {
+    if (!remove(key, oldValue)) {
+        return false;
+    }
+    insert(key, newValue);
+    return true;
 }
 
-template <typename K, typename V>
-void BTree<K, V>::clear(BTreeNode<K, V>* node) {
-    if (node) {
-        for (auto child : node->children) {
-            clear(child);
-        }
-        node->children.clear();
-        delete node;
+template <typename K, typename V, int T>
+V* BPlusTree<K, V, T>::search(K key) {
+    int i;
+    Node* node = leafFor(key, i);
+    if (i == node->count) {
+        node = node->next;
+        i = 0;
+    }
+    
+    if (node && i < node->count && node->keys[i] == key) {
+        return &node->values[i];
     }
+    return nullptr;
 }
 
-template <typename K, typename V>
-void BTree<K, V>::insert(K key, V value) {
-    if (root->keys.size() == 2 * t - 1) {
-        BTreeNode<K, V>* s = new BTreeNode<K, V>(t, false);
-        s->children.push_back(root);
-        s->splitChild(0, root);
-        root = s;
+template <typename K, typename V, int T>
+vector<V> BPlusTree<K, V, T>::searchRange(K minKey, K maxKey) {
+    vector<V> results;
+    int i;
+    for (Node* node = leafFor(minKey, i); node; node = node->next, i = 0) {
+        for (; i < node->count; i++) {
+            if (node->keys[i] > maxKey) {
+                return results;
+            }
+            results.push_back(node->values[i]);
+        }
     }
-    root->insertNonFull(key, value);
+    return results;
 }
 
-template <typename K, typename V>
-V* BTree<K, V>::search(K key) {
-    return root->search(key);
+template <typename K, typename V, int T>
+KeyStats<K> BPlusTree<K, V, T>::rangeStats(K minKey, K maxKey) {
+    KeyStats<K> result;
+    aggregate(root, minKey, maxKey, false, false, result);
+    return result;
 }
 
-template <typename K, typename V>
-vector<V> BTree<K, V>::searchRange(K minKey, K maxKey) {
-    vector<V> results;
-    root->searchRange(minKey, maxKey, results);
+template <typename K, typename V, int T>
+vector<pair<K, V>> BPlusTree<K, V, T>::getAllPairs() {
+    vector<pair<K, V>> results;
+    results.reserve(root->stats.count);
+    for (Node* node = firstLeaf(); node; node = node->next) {
+        for (int i = 0; i < node->count; i++) {
+            results.push_back(make_pair(node->keys[i], node->values[i]));
+        }
+    }
     return results;
 }
 
-template <typename K, typename V>
-void BTree<K, V>::traverse() {
-    if (root) {
-        root->traverse();
+template <typename K, typename V, int T>
+template <typename F>
+void BPlusTree<K, V, T>::forEachAscending(F visit) {
+    for (Node* node = firstLeaf(); node; node = node->next) {
+        for (int i = 0; i < node->count; i++) {
+            if (!visit(node->keys[i], node->values[i])) {
+                return;
+            }
+        }
+    }
+}
+
+template <typename K, typename V, int T>
+template <typename F>
+void BPlusTree<K, V, T>::forEachDescending(F visit) {
+    for (Node* node = lastLeaf(); node; node = node->prev) {
+        for (int i = node->count; i-- > 0;) {
+            if (!visit(node->keys[i], node->values[i])) {
+                return;
+            }
+        }
+    }
+}
+
+template <typename K, typename V, int T>
+void BPlusTree<K, V, T>::traverse() {
+    for (Node* node = firstLeaf(); node; node = node->next) {
+        for (int i = 0; i < node->count; i++) {
+            cout << node->keys[i] << " ";
+        }
     }
     cout << endl;
 }
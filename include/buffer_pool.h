@@ -0,0 +1,88 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include "hashtable.h"
+#include <string>
+#include <vector>
+#include <cstddef>
+
+using namespace std;
+
+const size_t BUFFER_PAGE_SIZE = 8 * 1024;
+const size_t DEFAULT_BUFFER_POOL_BYTES = 4 * 1024 * 1024;
+
+struct BufferPoolStats {
+    long long hits;
+    long long misses;
+    long long evictions;
+    long long writebacks;
+    int residentPages;
+    int pinnedPages;
+    int dirtyPages;
+    int capacityPages;
+    
+    BufferPoolStats() : hits(0), misses(0), evictions(0), writebacks(0), residentPages(0), pinnedPages(0), dirtyPages(0), capacityPages(0) {}
+    
+    double hitRate() const {
+        long long lookups = hits + misses;
+        return lookups == 0 ? 0.0 : (double)hits / lookups;
+    }
+};
+
+// Fixed-size pages of one file held in a bounded set of frames. Pinned frames are never evicted;
+// everything else is replaced by the clock algorithm, writing dirty pages back first.
+class BufferPool {
+private:
+    struct Frame {
+        long long pageNo;
+        vector<char> data;
+        size_t validBytes;
+        int pinCount;
+        bool dirty;
+        bool referenced;
+    };
+    
+    string path;
+    int fd;
+    long long fileSize;
+    vector<Frame> frames;
+    HashTable<long long, int> pageTable;
+    size_t clockHand;
+    int capacityPages;
+    
+    long long hits;
+    long long misses;
+    long long evictions;
+    long long writebacks;
+    
+    int findVictim();
+    bool loadPage(Frame& frame, long long pageNo);
+    bool writeBack(Frame& frame);
+    void shrink();
+    
+public:
+    BufferPool(size_t capacityBytes = DEFAULT_BUFFER_POOL_BYTES);
+    ~BufferPool();
+    
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+    
+    bool open(const string& filepath);
+    void close();
+    
+    const char* pin(long long pageNo, size_t& validBytes);
+    void unpin(long long pageNo, bool dirty = false);
+    
+    bool read(long long offset, size_t length, string& out);
+    bool write(long long offset, const char* data, size_t length);
+    bool flush();
+    bool sync();
+    
+    void setCapacity(size_t capacityBytes);
+    BufferPoolStats getStats() const;
+    
+    bool isOpen() const { return fd >= 0; }
+    long long getFileSize() const { return fileSize; }
+};
+
+#endif
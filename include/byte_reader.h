@@ -0,0 +1,58 @@
+#ifndef BYTE_READER_H
+#define BYTE_READER_H
+
+#include <string>
+#include <cstring>
+#include <cstddef>
+
+using namespace std;
+
+struct ByteReader {
+    const char* data;
+    size_t size;
+    size_t pos;
+    bool ok;
+    
+    ByteReader(const char* d, size_t s, size_t p = 0) : data(d), size(s), pos(p), ok(p <= s) {}
+    
+    bool has(size_t n) const {
+        return ok && n <= size - pos;
+    }
+    
+    template <typename T>
+    T read() {
+        T value = T();
+        if (!has(sizeof(T))) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, data + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+    
+    const char* readBytes(size_t n) {
+        if (!has(n)) {
+            ok = false;
+            return nullptr;
+        }
+        const char* start = data + pos;
+        pos += n;
+        return start;
+    }
+    
+    string readString() {
+        int len = read<int>();
+        if (len < 0) {
+            ok = false;
+            return "";
+        }
+        if (len == 0) {
+            return "";
+        }
+        const char* bytes = readBytes(len);
+        return bytes ? string(bytes, len) : "";
+    }
+};
+
+#endif
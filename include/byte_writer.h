@@ -0,0 +1,25 @@
+#ifndef BYTE_WRITER_H
+#define BYTE_WRITER_H
+
+#include <string>
+
+using namespace std;
+
+struct ByteWriter {
+    string& out;
+    
+    ByteWriter(string& buffer) : out(buffer) {}
+    
+    template <typename T>
+    void write(const T& value) {
+        out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+    
+    void writeString(const string& str) {
+        int len = str.length();
+        write(len);
+        out.append(str);
+    }
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef COLUMN_STORE_H
+#define COLUMN_STORE_H
+
+#include "hashtable.h"
+#include "btree.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+const int COLUMN_STORE_VERSION = 1;
+
+// Contiguous rating/price columns with the record offset of each row.
+// Removed rows keep their slot with NaN values so every range test rejects them.
+class ColumnStore {
+private:
+    vector<float> ratings;
+    vector<float> prices;
+    vector<long long> offsets;
+    HashTable<long long, int> rowOf;
+    int liveRows;
+
+public:
+    ColumnStore();
+    
+    void append(long long offset, float rating, float price);
+    void remove(long long offset);
+    void clear();
+    void swap(ColumnStore& other);
+    
+    vector<long long> filter(float minRating, float maxRating, float minPrice, float maxPrice) const;
+    int count(float minRating, float maxRating, float minPrice, float maxPrice) const;
+    bool matches(long long offset, float minRating, float maxRating, float minPrice, float maxPrice) const;
+    bool lookup(long long offset, float& rating, float& price) const;
+    void aggregate(float minRating, float maxRating, float minPrice, float maxPrice, KeyStats<float>& ratingStats, KeyStats<float>& priceStats) const;
+    
+    bool save(const string& path, long long coveredLength) const;
+    bool load(const string& path, long long coveredLength);
+    
+    int getRowCount() const { return offsets.size(); }
+    int getLiveRows() const { return liveRows; }
+    static const char* kernelName();
+};
+
+#endif
@@ -4,57 +4,336 @@
 #include "btree.h"
 #include "hashtable.h"
 #include "food_spot_structures.h"
+#include "mapped_file.h"
+#include "byte_reader.h"
+#include "restaurant_view.h"
+#include "record_format.h"
+#include "append_file.h"
+#include "lru_cache.h"
+#include "column_store.h"
+#include "buffer_pool.h"
+#include "block_index.h"
 #include <fstream>
 #include <string>
 #include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <memory>
 
 using namespace std;
 typedef long long FileOffset;
 
+const int INDEX_SNAPSHOT_VERSION = 7;
+const int INDEX_CHECKPOINT_INTERVAL = 100;
+const size_t DEFAULT_RECORD_CACHE_BYTES = 4 * 1024 * 1024;
+const size_t DEFAULT_MEMORY_BUDGET_BYTES = 8 * 1024 * 1024;
+const size_t DEFAULT_BLOCK_CACHE_BYTES = 1024 * 1024;
+const size_t MIN_BLOCK_RECORDS = 8;
+const FileOffset COALESCE_GAP_BYTES = 16 * 1024;
+const FileOffset MAX_COALESCED_READ = 1024 * 1024;
+const size_t MIN_FRAMES_PER_CHUNK = 4096;
+const char TENANT_SEPARATOR = '/';
+
+enum StorageMode {
+    STORAGE_STREAM,
+    STORAGE_MMAP,
+    STORAGE_PAGED
+};
+
+enum IndexState {
+    INDEX_READY,
+    INDEX_MISSING,
+    INDEX_BUILDING
+};
+
+enum DurabilityLevel {
+    DURABILITY_NONE,
+    DURABILITY_BATCH,
+    DURABILITY_WRITE
+};
+
+// Blocks are written by batch inserts and by compaction; single writes stay plain until the next compaction.
+// Files with blocks are readable whatever the setting.
+enum CompressionMode {
+    COMPRESSION_NONE,
+    COMPRESSION_BLOCKS
+};
+
+struct CompactionStats {
+    FileOffset bytesBefore;
+    FileOffset bytesAfter;
+    int liveRecords;
+    int droppedRecords;
+    double elapsedMs;
+    
+    CompactionStats() : bytesBefore(0), bytesAfter(0), liveRecords(0), droppedRecords(0), elapsedMs(0.0) {}
+    
+    FileOffset reclaimedBytes() const {
+        return bytesBefore - bytesAfter;
+    }
+};
+
+enum SortField {
+    SORT_BY_RATING,
+    SORT_BY_PRICE
+};
+
+struct GroupStats {
+    string key;
+    int count;
+    KeyStats<float> rating;
+    KeyStats<float> price;
+    
+    GroupStats() : count(0) {}
+};
+
+// nextCursor resumes the scan; it is empty once the file is exhausted.
+// Cursors carry the data file's id, so one issued before a compaction moved the records stays invalid
+// across restarts; valid is false for those and for malformed cursors.
+struct RestaurantPage {
+    vector<Restaurant> restaurants;
+    string nextCursor;
+    bool valid;
+    
+    RestaurantPage() : valid(true) {}
+};
+
+// Conjunction of optional predicates; empty strings and unset ranges match everything.
+// tenant limits the query to the records one user owns in a shared database.
+struct RestaurantQuery {
+    string tenant;
+    string cuisine;
+    string location;
+    bool hasRating;
+    float minRating;
+    float maxRating;
+    bool hasPrice;
+    float minPrice;
+    float maxPrice;
+    
+    RestaurantQuery() : hasRating(false), minRating(0), maxRating(0), hasPrice(false), minPrice(0), maxPrice(0) {}
+    
+    void setRating(float low, float high) {
+        hasRating = true;
+        minRating = low;
+        maxRating = high;
+    }
+    
+    void setPrice(float low, float high) {
+        hasPrice = true;
+        minPrice = low;
+        maxPrice = high;
+    }
+};
+
+// Shared databases key every record as "<tenant>/<restaurantId>"; plain ids have no tenant.
+inline string tenantKey(const string& tenant, const string& id) {
+    return tenant.empty() ? id : tenant + TENANT_SEPARATOR + id;
+}
+
+inline string_view tenantOf(string_view key) {
+    size_t split = key.rfind(TENANT_SEPARATOR);
+    return split == string_view::npos ? string_view() : key.substr(0, split);
+}
+
+inline string_view localId(string_view key) {
+    size_t split = key.rfind(TENANT_SEPARATOR);
+    return split == string_view::npos ? key : key.substr(split + 1);
+}
+
+// A decompressed block with where each slot's frame starts, so reading any record in it is one lookup.
+struct DecodedBlock {
+    string frames;
+    vector<uint32_t> slots;
+};
+
+// Indexes built off to the side by a background rebuild and swapped in when it finishes.
+struct IndexSet {
+    BPlusTree<float, FileOffset> ratingIndex;
+    BPlusTree<float, FileOffset> priceIndex;
+    HashTable<string, FileOffset> idIndex;
+    MultiValueHashTable<StringCode, FileOffset> cuisineIndex;
+    MultiValueHashTable<StringCode, FileOffset> locationIndex;
+    MultiValueHashTable<string, FileOffset> tenantIndex;
+    ColumnStore columns;
+    StringDictionary dictionary;
+    int maxId;
+    FileOffset validEnd;
+    
+    IndexSet() : idIndex(1000), cuisineIndex(500), locationIndex(200), tenantIndex(100), maxId(0), validEnd(0) {}
+};
+
 class DiskDatabase {
 private:
     string dataFilePath;
+    string indexFilePath;
+    string columnFilePath;
+    StorageMode storageMode;
+    DurabilityLevel durability;
+    CompressionMode compression;
+    MappedFile mappedData;
+    AppendFile appendLog;
+    BufferPool bufferPool;
     
-    BTree<float, FileOffset> ratingIndex;
-    BTree<float, FileOffset> priceIndex;
+    BPlusTree<float, FileOffset> ratingIndex;
+    BPlusTree<float, FileOffset> priceIndex;
     
     HashTable<string, FileOffset> idIndex;
-    MultiValueHashTable<string, FileOffset> cuisineIndex;
-    MultiValueHashTable<string, FileOffset> locationIndex;
+    MultiValueHashTable<StringCode, FileOffset> cuisineIndex;
+    MultiValueHashTable<StringCode, FileOffset> locationIndex;
+    MultiValueHashTable<string, FileOffset> tenantIndex;
+    
+    int deadRecords;
+    LRUCache<FileOffset, Restaurant> recordCache;
+    ColumnStore columns;
+    StringDictionary dictionary;
+    BlockIndex blockIndex;
+    LRUCache<FileOffset, shared_ptr<const DecodedBlock>> blockCache;
     
     int nextId;
+    int writesSinceCheckpoint;
+    
+    mutable recursive_mutex dbMutex;
+    thread compactionThread;
+    atomic<bool> compacting;
+    CompactionStats lastCompaction;
+    uint64_t fileId;
+    int rebuildThreads;
+    
+    IndexState indexState;
+    thread indexThread;
+    unique_ptr<IndexSet> stagedIndexes;
+    FileOffset stagedCutoff;
+    atomic<bool> indexBuildDone;
     
     string generateId();
     FileOffset writeRestaurantToDisk(const Restaurant& r);
+    vector<FileOffset> writeRestaurantsToDisk(const vector<Restaurant>& batch, bool sync);
+    vector<FileOffset> appendRecords(RecordType type, const vector<string>& payloads, bool sync, const string& prefix = string());
+    vector<FileOffset> appendBlocks(const vector<Restaurant>& batch, const vector<string>& payloads, bool sync, const string& prefix);
+    bool openAppendTarget();
+    FileOffset appendPosition();
+    bool appendBytes(const string& bytes);
+    bool syncAppends();
     Restaurant readRestaurantFromDisk(FileOffset offset);
-    void rebuildIndexes();
+    Restaurant readRestaurantFromMapping(FileOffset offset);
+    Restaurant readRestaurantFromStream(FileOffset offset);
+    Restaurant readRestaurantFromPool(FileOffset offset);
+    Restaurant readRestaurantFromBlock(FileOffset offset);
+    shared_ptr<const DecodedBlock> loadBlock(FileOffset blockOffset);
+    vector<Restaurant> fetchRestaurants(const vector<FileOffset>& offsets);
+    bool ensureMapped(FileOffset offset);
+    bool mappedPayload(FileOffset offset, ByteReader& reader);
+    vector<RestaurantView> readViews(const vector<FileOffset>& offsets);
+    vector<FileOffset> queryOffsets(const RestaurantQuery& q);
+    vector<FileOffset> topKOffsets(SortField field, int k, const RestaurantQuery& filter, bool descending);
+    vector<GroupStats> groupStats(const MultiValueHashTable<StringCode, FileOffset>& index, const vector<FileOffset>* within = nullptr);
+    const vector<FileOffset>& tenantOffsets(const string& tenant);
+    void indexTenant(const string& key, FileOffset offset);
+    void indexRestaurant(const Restaurant& r, FileOffset offset);
+    void unindexRestaurant(const Restaurant& r, FileOffset offset);
+    void applyTombstone(const string& id);
+    bool isLiveRecord(const string& id, FileOffset offset);
+    void clearIndexes();
+    void rebuildColumns();
+    void runCompaction();
+    void noteWrites(int count);
+    void rebuildIndexes(FileOffset startOffset = 0);
+    void scanRecordBounds();
+    void startIndexBuild();
+    void installStagedIndexes();
+    bool useIndexes();
+    void ensureIndexes();
+    vector<FileOffset> scanOffsets(const RestaurantQuery& q);
+    vector<FileOffset> ratingOffsets(float minRating, float maxRating);
+    vector<FileOffset> priceOffsets(float minPrice, float maxPrice);
+    vector<FileOffset> cuisineOffsets(const string& cuisine);
+    vector<FileOffset> locationOffsets(const string& location);
+    vector<FileOffset> rangeOffsets(float minRating, float maxRating, float minPrice, float maxPrice);
+    void recoverTornTail(FileOffset validEnd);
+    bool loadIndexSnapshot();
+    bool saveIndexSnapshot();
+    FileOffset getDataFileLength();
+    uint64_t readDataFileId();
+    void checkDataFormat();
+    bool migrateLegacyFile();
+    bool migratePlainStrings();
+    bool replaceDataFile(const string& contents, const string& backupSuffix);
     
     void writeString(ofstream& file, const string& str);
-    string readString(ifstream& file);
-    void writeStringVector(ofstream& file, const vector<string>& vec);
-    vector<string> readStringVector(ifstream& file);
-    void writeDish(ofstream& file, const Dish& dish);
-    Dish readDish(ifstream& file);
-    void writeDishVector(ofstream& file, const vector<Dish>& dishes);
-    vector<Dish> readDishVector(ifstream& file);
-
+    
 public:
-    DiskDatabase(const string& filepath = "restaurants_data.dat");
+    DiskDatabase(const string& filepath = "restaurants_data.dat", StorageMode mode = STORAGE_MMAP, int threads = 0);
     ~DiskDatabase();
     
-    string addRestaurant(const string& name, const string& location,const vector<string>& cuisineTypes, float rating, float avgPrice, const vector<Dish>& dishes, const string& notes = "");
+    string addRestaurant(const string& name, const string& location,const vector<string>& cuisineTypes, float rating, float avgPrice, const vector<Dish>& dishes, const string& notes = "", const string& tenant = "");
+    vector<string> addRestaurants(const vector<Restaurant>& batch, bool sync = false, const string& tenant = "");
+    int importRestaurants(const vector<Restaurant>& batch, const string& tenant);
+    
+    bool updateRestaurant(const Restaurant& r);
+    bool updateRating(const string& id, float rating);
+    bool recordVisit(const string& id);
+    bool deleteRestaurant(const string& id);
     
     vector<Restaurant> searchByRatingRange(float minRating, float maxRating);
     vector<Restaurant> searchByPriceRange(float minPrice, float maxPrice);
     vector<Restaurant> searchByCuisine(const string& cuisine);
     vector<Restaurant> searchByLocation(const string& location);
     
+    vector<RestaurantView> searchViewsByRatingRange(float minRating, float maxRating);
+    vector<RestaurantView> searchViewsByPriceRange(float minPrice, float maxPrice);
+    vector<RestaurantView> searchViewsByCuisine(const string& cuisine);
+    vector<RestaurantView> searchViewsByLocation(const string& location);
+    
+    vector<Restaurant> searchByRatingAndPrice(float minRating, float maxRating, float minPrice, float maxPrice);
+    vector<RestaurantView> searchViewsByRatingAndPrice(float minRating, float maxRating, float minPrice, float maxPrice);
+    int countByRatingAndPrice(float minRating, float maxRating, float minPrice, float maxPrice);
+    
+    vector<Restaurant> query(const RestaurantQuery& q);
+    vector<RestaurantView> queryViews(const RestaurantQuery& q);
+    
+    vector<Restaurant> topK(SortField field, int k, const RestaurantQuery& filter = RestaurantQuery(), bool descending = true);
+    vector<RestaurantView> topKViews(SortField field, int k, const RestaurantQuery& filter = RestaurantQuery(), bool descending = true);
+    
+    KeyStats<float> getFieldStats(SortField field);
+    KeyStats<float> getFieldStats(SortField field, float minKey, float maxKey);
+    KeyStats<float> getTenantFieldStats(const string& tenant, SortField field);
+    vector<GroupStats> getCuisineStats();
+    vector<GroupStats> getLocationStats();
+    vector<GroupStats> getTenantCuisineStats(const string& tenant);
+    vector<GroupStats> getTenantLocationStats(const string& tenant);
+    
     Restaurant getRestaurant(const string& id);
     
     void displayAll();
     
-    int getTotalRestaurants() const;
+    void checkpointIndexes();
+    StorageMode getStorageMode() const;
+    void setDurability(DurabilityLevel level);
+    DurabilityLevel getDurability() const;
+    void setCompression(CompressionMode mode);
+    CompressionMode getCompression() const;
+    void setRebuildThreads(int threads);
+    int getRebuildThreads() const;
+    
+    CompactionStats compact();
+    bool startCompaction();
+    bool isCompacting() const;
+    CompactionStats getLastCompactionStats() const;
+    int getDeadRecordCount() const;
+    CacheStats getCacheStats() const;
+    void setCacheCapacity(size_t bytes);
+    void setMemoryBudget(size_t bytes);
+    BufferPoolStats getBufferPoolStats() const;
+    TreeMemoryStats getIndexMemoryStats(SortField field) const;
+    
+    bool indexesReady() const;
+    int getTotalRestaurants();
+    int getTenantRestaurantCount(const string& tenant);
+    vector<string> getTenants();
     vector<Restaurant> getAllRestaurants();
+    RestaurantPage getRestaurantPage(const string& cursor, int limit, const string& tenant = "");
 };
 
 #endif
\ No newline at end of file
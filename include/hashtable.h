@@ -6,6 +6,7 @@
 #include <string>
 #include <functional>
 #include <algorithm>
+#include <utility>
 
 using namespace std;
 
@@ -75,6 +76,10 @@ public:
         return nullptr;
     }
     
+    const V* get(const K& key) const {
+        return const_cast<HashTable*>(this)->get(key);
+    }
+    
     bool remove(const K& key) {
         int index = hashFunction(key);
         
@@ -94,6 +99,19 @@ public:
         return const_cast<HashTable*>(this)->get(key) != nullptr;
     }
     
+    void clear() {
+        for (auto& bucket : table) {
+            bucket.clear();
+        }
+        count = 0;
+    }
+    
+    void swap(HashTable& other) {
+        table.swap(other.table);
+        std::swap(size, other.size);
+        std::swap(count, other.count);
+    }
+    
     int getSize() const {
         return count;
     }
@@ -117,6 +135,16 @@ public:
         }
         return values;
     }
+    
+    vector<pair<K, V>> getAllEntries() const {
+        vector<pair<K, V>> entries;
+        for (const auto& bucket : table) {
+            for (const auto& entry : bucket) {
+                entries.push_back(make_pair(entry.key, entry.value));
+            }
+        }
+        return entries;
+    }
 };
 
 template <typename K, typename V>
@@ -137,17 +165,17 @@ private:
     }
     
     void rehash() {
-        vector<list<Entry>> oldTable = table;
+        vector<list<Entry>> oldTable;
+        oldTable.swap(table);
         size *= 2;
-        table.clear();
         table.resize(size);
         count = 0;
         
+        // Keys are already unique, so whole entries move over without the per-value duplicate check.
         for (auto& bucket : oldTable) {
             for (auto& entry : bucket) {
-                for (auto& value : entry.values) {
-                    insert(entry.key, value);
-                }
+                table[hashFunction(entry.key)].push_back(move(entry));
+                count++;
             }
         }
     }
@@ -179,6 +207,43 @@ public:
         }
     }
     
+    // Keeps the key's values sorted, for lists callers binary-search; appending the largest value is O(1).
+    void insertSorted(const K& key, const V& value) {
+        int index = hashFunction(key);
+        
+        for (auto& entry : table[index]) {
+            if (entry.key == key) {
+                auto position = lower_bound(entry.values.begin(), entry.values.end(), value);
+                if (position == entry.values.end() || *position != value) {
+                    entry.values.insert(position, value);
+                }
+                return;
+            }
+        }
+        
+        insert(key, value);
+    }
+    
+    void insertAll(const K& key, const vector<V>& values) {
+        int index = hashFunction(key);
+        
+        for (auto& entry : table[index]) {
+            if (entry.key == key) {
+                entry.values.insert(entry.values.end(), values.begin(), values.end());
+                return;
+            }
+        }
+        
+        Entry newEntry(key);
+        newEntry.values = values;
+        table[index].push_back(newEntry);
+        count++;
+        
+        if ((float)count / size > 0.7) {
+            rehash();
+        }
+    }
+    
     vector<V> get(const K& key) const {
         int index = hashFunction(key);
         
@@ -191,15 +256,36 @@ public:
         return vector<V>();
     }
     
+    const vector<V>* getValues(const K& key) const {
+        int index = hashFunction(key);
+        
+        for (const auto& entry : table[index]) {
+            if (entry.key == key) {
+                return &entry.values;
+            }
+        }
+        
+        return nullptr;
+    }
+    
+    int getCount(const K& key) const {
+        const vector<V>* values = getValues(key);
+        return values ? values->size() : 0;
+    }
+    
     bool remove(const K& key, const V& value) {
         int index = hashFunction(key);
         
         auto& bucket = table[index];
-        for (auto& entry : bucket) {
-            if (entry.key == key) {
-                auto it = find(entry.values.begin(), entry.values.end(), value);
-                if (it != entry.values.end()) {
-                    entry.values.erase(it);
+        for (auto entryIt = bucket.begin(); entryIt != bucket.end(); ++entryIt) {
+            if (entryIt->key == key) {
+                auto it = find(entryIt->values.begin(), entryIt->values.end(), value);
+                if (it != entryIt->values.end()) {
+                    entryIt->values.erase(it);
+                    if (entryIt->values.empty()) {
+                        bucket.erase(entryIt);
+                        count--;
+                    }
                     return true;
                 }
             }
@@ -235,6 +321,19 @@ public:
         return false;
     }
     
+    void clear() {
+        for (auto& bucket : table) {
+            bucket.clear();
+        }
+        count = 0;
+    }
+    
+    void swap(MultiValueHashTable& other) {
+        table.swap(other.table);
+        std::swap(size, other.size);
+        std::swap(count, other.count);
+    }
+    
     int getSize() const {
         return count;
     }
@@ -0,0 +1,112 @@
+#ifndef LRU_CACHE_H
+#define LRU_CACHE_H
+
+#include "hashtable.h"
+#include <list>
+#include <cstddef>
+
+using namespace std;
+
+struct CacheStats {
+    long long hits;
+    long long misses;
+    int entries;
+    size_t bytes;
+    size_t capacityBytes;
+    
+    CacheStats() : hits(0), misses(0), entries(0), bytes(0), capacityBytes(0) {}
+    
+    double hitRate() const {
+        long long lookups = hits + misses;
+        return lookups == 0 ? 0.0 : (double)hits / lookups;
+    }
+};
+
+template <typename K, typename V>
+class LRUCache {
+private:
+    struct Node {
+        K key;
+        V value;
+        size_t bytes;
+        Node(const K& k, const V& v, size_t b) : key(k), value(v), bytes(b) {}
+    };
+    
+    list<Node> order;
+    HashTable<K, typename list<Node>::iterator> lookup;
+    size_t capacityBytes;
+    size_t usedBytes;
+    long long hits;
+    long long misses;
+    
+    void evict() {
+        while (usedBytes > capacityBytes && !order.empty()) {
+            Node& victim = order.back();
+            usedBytes -= victim.bytes;
+            lookup.remove(victim.key);
+            order.pop_back();
+        }
+    }
+
+public:
+    LRUCache(size_t capacity) : lookup(256), capacityBytes(capacity), usedBytes(0), hits(0), misses(0) {}
+    
+    bool get(const K& key, V& value) {
+        auto* it = lookup.get(key);
+        if (!it) {
+            misses++;
+            return false;
+        }
+        
+        order.splice(order.begin(), order, *it);
+        value = (*it)->value;
+        hits++;
+        return true;
+    }
+    
+    void put(const K& key, const V& value, size_t bytes) {
+        erase(key);
+        if (bytes > capacityBytes) {
+            return;
+        }
+        
+        order.push_front(Node(key, value, bytes));
+        lookup.insert(key, order.begin());
+        usedBytes += bytes;
+        evict();
+    }
+    
+    void erase(const K& key) {
+        auto* it = lookup.get(key);
+        if (!it) {
+            return;
+        }
+        
+        usedBytes -= (*it)->bytes;
+        order.erase(*it);
+        lookup.remove(key);
+    }
+    
+    void clear() {
+        order.clear();
+        lookup.clear();
+        usedBytes = 0;
+    }
+    
+    void setCapacity(size_t capacity) {
+        capacityBytes = capacity;
+        evict();
+    }
+    
+    CacheStats getStats() const {
+        CacheStats stats;
+        stats.hits = hits;
+        stats.misses = misses;
+        stats.entries = order.size();
+        stats.bytes = usedBytes;
+        stats.capacityBytes = capacityBytes;
+        return stats;
+    }
+};
+
+#endif
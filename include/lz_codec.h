@@ -0,0 +1,18 @@
+#ifndef LZ_CODEC_H
+#define LZ_CODEC_H
+
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+const size_t LZ_MIN_MATCH = 4;
+const size_t LZ_MAX_OFFSET = 65535;
+const int LZ_HASH_BITS = 12;
+
+// Byte-oriented LZ77 in the LZ4 style: no entropy coding, so decompression is a tight copy loop.
+// The output does not record its own length; callers store the raw length next to it.
+void lzCompress(const char* data, size_t length, string& out);
+bool lzDecompress(const char* data, size_t length, size_t rawLength, string& out);
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include <memory>
+
+using namespace std;
+
+// The mapping itself is shared: it is unmapped only once close() or remap() has dropped it and no
+// region handed out by getRegion() is still held.
+class MappedFile {
+private:
+    string path;
+    const char* data;
+    size_t length;
+    shared_ptr<const char> region;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fd;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+    
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    
+    bool open(const string& filepath);
+    bool remap();
+    void close();
+    
+    bool isOpen() const { return data != nullptr; }
+    const char* getData() const { return data; }
+    shared_ptr<const char> getRegion() const { return region; }
+    size_t getSize() const { return length; }
+};
+
+#endif
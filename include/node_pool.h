@@ -0,0 +1,115 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <utility>
+
+using namespace std;
+
+const int NODE_POOL_SLAB_NODES = 64;
+
+struct NodePoolStats {
+    long long allocations;
+    long long reuses;
+    int liveNodes;
+    int freeNodes;
+    int slabs;
+    size_t liveBytes;
+    size_t reservedBytes;
+    
+    NodePoolStats() : allocations(0), reuses(0), liveNodes(0), freeNodes(0), slabs(0), liveBytes(0), reservedBytes(0) {}
+};
+
+// Fixed-size slots for one node type, carved from slabs of NODE_POOL_SLAB_NODES. A freed slot goes on a
+// free list and is handed out before a new slab is taken; slabs are only returned all at once by clear().
+// The pool hands out raw memory: callers construct with placement new and destroy before release().
+template <typename T>
+class NodePool {
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+    
+    vector<Slot*> slabs;
+    Slot* freeList;
+    int slabUsed;
+    
+    long long allocations;
+    long long reuses;
+    int liveNodes;
+    int freeNodes;
+    
+public:
+    NodePool() : freeList(nullptr), slabUsed(0), allocations(0), reuses(0), liveNodes(0), freeNodes(0) {}
+    ~NodePool() { clear(); }
+    
+    NodePool(const NodePool&) = delete;
+    NodePool& operator=(const NodePool&) = delete;
+    
+    T* allocate() {
+        allocations++;
+        liveNodes++;
+    
+        if (freeList) {
+            Slot* slot = freeList;
+            freeList = slot->next;
+            freeNodes--;
+            reuses++;
+            return reinterpret_cast<T*>(slot->storage);
+        }
+    
+        if (slabs.empty() || slabUsed == NODE_POOL_SLAB_NODES) {
+            void* slab = ::operator new(NODE_POOL_SLAB_NODES * sizeof(Slot), align_val_t(alignof(Slot)));
+            slabs.push_back(static_cast<Slot*>(slab));
+            slabUsed = 0;
+        }
+        return reinterpret_cast<T*>(slabs.back()[slabUsed++].storage);
+    }
+    
+    void release(T* node) {
+        Slot* slot = reinterpret_cast<Slot*>(node);
+        slot->next = freeList;
+        freeList = slot;
+        liveNodes--;
+        freeNodes++;
+    }
+    
+    // Frees every slab without touching the slots; anything still constructed in them must need no destructor.
+    void clear() {
+        for (auto slab : slabs) {
+            ::operator delete(slab, align_val_t(alignof(Slot)));
+        }
+        slabs.clear();
+        freeList = nullptr;
+        slabUsed = 0;
+        liveNodes = 0;
+        freeNodes = 0;
+    }
+    
+    void swap(NodePool& other) {
+        slabs.swap(other.slabs);
+        std::swap(freeList, other.freeList);
+        std::swap(slabUsed, other.slabUsed);
+        std::swap(allocations, other.allocations);
+        std::swap(reuses, other.reuses);
+        std::swap(liveNodes, other.liveNodes);
+        std::swap(freeNodes, other.freeNodes);
+    }
+    
+    NodePoolStats getStats() const {
+        NodePoolStats stats;
+        stats.allocations = allocations;
+        stats.reuses = reuses;
+        stats.liveNodes = liveNodes;
+        stats.freeNodes = freeNodes;
+        stats.slabs = slabs.size();
+        stats.liveBytes = liveNodes * sizeof(Slot);
+        stats.reservedBytes = slabs.size() * NODE_POOL_SLAB_NODES * sizeof(Slot);
+        return stats;
+    }
+};
+
+#endif
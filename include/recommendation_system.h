@@ -3,6 +3,7 @@
 
 #include "food_spot_structures.h"
 #include "user_manager.h"
+#include "storage_engine.h"
 #include <unordered_map>
 #include <vector>
 #include <queue>
@@ -40,6 +41,7 @@ struct ScoredRestaurant {
 class RecommendationSystem {
 private:
     UserManager* userManager;
+    StorageEngine* storage;
     unordered_map<string, unordered_map<string, int>> userCuisinePreferences;
 
     vector<string> getTopCuisines(const string& userID, int topN = 3);
@@ -49,7 +51,7 @@ private:
     vector<Restaurant> loadFriendsRestaurants(const string& userID);
 
 public:
-    RecommendationSystem(UserManager* um);
+    RecommendationSystem(UserManager* um, StorageEngine* engine = nullptr);
 
     void updatePreferences(const string& userID, const vector<string>& cuisines);
 
@@ -0,0 +1,114 @@
+#ifndef RECORD_FORMAT_H
+#define RECORD_FORMAT_H
+
+#include "food_spot_structures.h"
+#include "byte_reader.h"
+#include "byte_writer.h"
+#include "string_dictionary.h"
+#include "lz_codec.h"
+#include <fstream>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+// Data file layout: an 8 byte file header ("FSDB" + version) followed by frames.
+// Each frame is [uint32 payload length][uint8 type][3 reserved][uint32 crc32] + payload.
+// Version 3 records carry cuisine and location as dictionary codes, defined by earlier dictionary frames.
+// A new data file opens with a file id frame: a random uint64 that the index snapshot records to know its file.
+const char DATA_FILE_MAGIC[] = "FSDB";
+const uint32_t DATA_FORMAT_VERSION = 3;
+const uint32_t PLAIN_STRINGS_FORMAT_VERSION = 2;
+const size_t FILE_HEADER_SIZE = 8;
+const size_t FRAME_HEADER_SIZE = 12;
+const uint32_t MAX_FRAME_PAYLOAD = 64 * 1024 * 1024;
+const size_t COMPRESSED_BLOCK_BYTES = 16 * 1024;
+const size_t BLOCK_HEADER_SIZE = 12;
+
+enum RecordType : uint8_t {
+    RECORD_RESTAURANT = 1,
+    RECORD_TOMBSTONE = 2,
+    RECORD_DICTIONARY = 3,
+    RECORD_BLOCK = 4,
+    RECORD_FILE_ID = 5
+};
+
+struct FrameHeader {
+    uint32_t length;
+    uint8_t type;
+    uint32_t checksum;
+    
+    FrameHeader() : length(0), type(0), checksum(0) {}
+};
+
+uint32_t crc32(const char* data, size_t length);
+
+void appendFileHeader(string& out);
+bool checkFileHeader(const char* data, size_t size);
+uint32_t fileFormatVersion(const char* data, size_t size);
+
+void appendFileId(string& out, uint64_t id);
+uint64_t readFileId(const char* data, size_t size);
+
+void appendFrame(string& out, RecordType type, const string& payload);
+bool readFrameHeader(const char* data, size_t size, size_t pos, FrameHeader& header);
+
+// The plain form is the version 2 and pre-framing layout, still read by the migrations.
+bool decodeRestaurant(ByteReader& reader, Restaurant& r);
+bool encodeRestaurant(const Restaurant& r, const StringDictionary& dictionary, string& out);
+bool decodeRestaurant(ByteReader& reader, const StringDictionary& dictionary, Restaurant& r);
+
+void encodeDictionaryEntry(StringCode code, const string& value, string& out);
+bool decodeDictionaryEntry(ByteReader& reader, StringCode& code, string& value);
+
+// A block payload is [uint32 raw length][uint32 record count][int32 highest rest_ number] followed by
+// the LZ-compressed restaurant frames, padded so that block offset + slot never leaves the block's frame.
+struct BlockHeader {
+    uint32_t rawLength;
+    uint32_t records;
+    int32_t maxIdNumber;
+    
+    BlockHeader() : rawLength(0), records(0), maxIdNumber(0) {}
+};
+
+void encodeBlock(const string& frames, uint32_t records, int maxIdNumber, string& out);
+bool readBlockHeader(const char* payload, size_t length, BlockHeader& header);
+bool decodeBlock(const char* payload, size_t length, string& frames);
+bool nextBlockFrame(const string& frames, size_t& pos, FrameHeader& header, const char*& payload);
+
+// Compressed blocks are opened in place: their records come out one at a time as block offset + slot.
+class RecordScanner {
+private:
+    ifstream file;
+    string buffer;
+    size_t bufferPos;
+    long long bufferStart;
+    bool corrupt;
+    bool eof;
+    
+    string block;
+    size_t blockPos;
+    long long blockOffset;
+    uint32_t blockSlot;
+    uint32_t blockRecords;
+    
+    bool fill(size_t needed);
+    bool nextInBlock(long long& offset, FrameHeader& header, const char*& payload);
+    
+public:
+    RecordScanner(const string& filepath, long long startOffset = FILE_HEADER_SIZE);
+    
+    bool isOpen() const { return file.is_open(); }
+    bool isCorrupt() const { return corrupt; }
+    
+    bool next(long long& offset, FrameHeader& header, const char*& payload);
+    long long position() const;
+    
+    long long currentBlock() const { return blockOffset; }
+    uint32_t currentBlockRecords() const { return blockRecords; }
+};
+
+// Reads the live restaurants of a data file of any version without migrating it or writing index files.
+vector<Restaurant> readRestaurantFile(const string& path);
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef RESTAURANT_VIEW_H
+#define RESTAURANT_VIEW_H
+
+#include "food_spot_structures.h"
+#include "byte_reader.h"
+#include "string_dictionary.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+
+using namespace std;
+
+// Points into a mapped record or a decompressed block and holds on to it through source, so a view
+// stays readable after the database is written to, remapped or compacted. Location and the first
+// cuisine are resolved from the dictionary at parse time; cuisines() looks the rest up again, so it
+// belongs under the database's lock.
+struct RestaurantView {
+    string_view restaurantId;
+    string_view name;
+    string_view location;
+    string_view cuisine;
+    string_view notes;
+    
+    float overallRating;
+    float averagePrice;
+    time_t lastVisitDate;
+    int totalVisits;
+    
+    StringCode locationCode;
+    int cuisineCount;
+    int dishCount;
+    const StringDictionary* dictionary;
+    const char* cuisineData;
+    size_t cuisineBytes;
+    const char* dishData;
+    size_t dishBytes;
+    shared_ptr<const void> source;
+    
+    RestaurantView() : overallRating(0.0), averagePrice(0.0), lastVisitDate(0), totalVisits(0), locationCode(NO_STRING_CODE), cuisineCount(0), dishCount(0), dictionary(nullptr), cuisineData(nullptr), cuisineBytes(0), dishData(nullptr), dishBytes(0) {}
+    
+    bool parse(ByteReader& reader, const StringDictionary& strings);
+    
+    string_view firstCuisine() const;
+    vector<string_view> cuisines() const;
+    bool hasCuisine(StringCode code) const;
+    vector<Dish> dishes() const;
+    
+    Restaurant materialize() const;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef STORAGE_ENGINE_H
+#define STORAGE_ENGINE_H
+
+#include "disk_database.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+const char SHARED_DATA_FILE[] = "data/restaurants_shared.dat";
+const char USER_DATA_DIR[] = "data/users";
+
+// One shared data file and index set for every user. Records are stored under "<userID>/<restaurantId>"
+// and every call is scoped to one user; ids handed back to callers are the user's own, unprefixed ones.
+class StorageEngine {
+private:
+    DiskDatabase db;
+    
+    static void stripTenant(Restaurant& r);
+    static void stripTenant(vector<Restaurant>& restaurants);
+    static void stripTenant(vector<RestaurantView>& views);
+    
+public:
+    StorageEngine(const string& filepath = SHARED_DATA_FILE, StorageMode mode = STORAGE_MMAP);
+    
+    string addRestaurant(const string& userID, const string& name, const string& location, const vector<string>& cuisineTypes, float rating, float avgPrice, const vector<Dish>& dishes, const string& notes = "");
+    vector<string> addRestaurants(const string& userID, const vector<Restaurant>& batch, bool sync = false);
+    bool updateRestaurant(const string& userID, const Restaurant& r);
+    bool deleteRestaurant(const string& userID, const string& id);
+    Restaurant getRestaurant(const string& userID, const string& id);
+    
+    vector<Restaurant> query(const string& userID, const RestaurantQuery& q);
+    vector<RestaurantView> queryViews(const string& userID, const RestaurantQuery& q);
+    vector<Restaurant> getUserRestaurants(const string& userID);
+    RestaurantPage getRestaurantPage(const string& userID, const string& cursor, int limit);
+    int getRestaurantCount(const string& userID);
+    
+    KeyStats<float> getFieldStats(const string& userID, SortField field);
+    vector<GroupStats> getCuisineStats(const string& userID);
+    vector<GroupStats> getLocationStats(const string& userID);
+    
+    int importUserFile(const string& userID, const string& path);
+    int importUserDirectory(const string& directory = USER_DATA_DIR);
+    
+    vector<string> getUsers();
+    DiskDatabase& getDatabase();
+};
+
+#endif
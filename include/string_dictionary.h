@@ -0,0 +1,69 @@
+#ifndef STRING_DICTIONARY_H
+#define STRING_DICTIONARY_H
+
+#include "hashtable.h"
+#include <string>
+#include <string_view>
+#include <deque>
+#include <cstdint>
+
+using namespace std;
+
+typedef uint32_t StringCode;
+const StringCode NO_STRING_CODE = 0xFFFFFFFFu;
+
+// Cuisine and location strings, each stored once per data file and referred to by code everywhere else.
+// Codes are handed out in file order; values sit in a deque so views can point at them while it grows.
+class StringDictionary {
+private:
+    deque<string> values;
+    HashTable<string, StringCode> codes;
+    
+public:
+    StringDictionary() : codes(256) {}
+    
+    StringCode lookup(const string& value) const {
+        const StringCode* code = codes.get(value);
+        return code ? *code : NO_STRING_CODE;
+    }
+    
+    // Entries must arrive in code order; repeating a known entry is accepted, anything else is corruption.
+    bool define(StringCode code, const string& value) {
+        if (code < values.size()) {
+            return values[code] == value;
+        }
+        if (code != values.size() || codes.contains(value)) {
+            return false;
+        }
+        values.push_back(value);
+        codes.insert(value, code);
+        return true;
+    }
+    
+    const string& value(StringCode code) const {
+        static const string missing;
+        return code < values.size() ? values[code] : missing;
+    }
+    
+    StringCode nextCode() const { return values.size(); }
+    int size() const { return values.size(); }
+    
+    void truncate(StringCode count) {
+        while (values.size() > count) {
+            codes.remove(values.back());
+            values.pop_back();
+        }
+    }
+    
+    void clear() {
+        values.clear();
+        codes.clear();
+    }
+    
+    void swap(StringDictionary& other) {
+        values.swap(other.values);
+        codes.swap(other.codes);
+    }
+};
+
+#endif
@@ -34,7 +34,7 @@ public:
     bool registerUser(const string& username, const string& email, const string& password);
     User* login(const string& username, const string& password);
     User* getUser(const string& userID);
-    void updateRestaurantCount(const string& userID);
+    void updateRestaurantCount(const string& userID, int added = 1);
     vector<User> getAllUsers();
     
     bool addFriend(const string& userID, const string& friendID);
@@ -0,0 +1,94 @@
+#include "../include/append_file.h"
+#include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+AppendFile::AppendFile() : fd(-1), size(0) {}
+
+AppendFile::~AppendFile() {
+    close();
+}
+
+bool AppendFile::open(const string& filepath) {
+    close();
+    path = filepath;
+    
+#ifdef _WIN32
+    fd = ::_open(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    fd = ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+#endif
+    if (fd < 0) {
+        cerr << "Error. can not open " << path << " for append" << endl;
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close();
+        return false;
+    }
+    
+    size = st.st_size;
+    return true;
+}
+
+void AppendFile::close() {
+    if (fd >= 0) {
+#ifdef _WIN32
+        ::_close(fd);
+#else
+        ::close(fd);
+#endif
+        fd = -1;
+    }
+}
+
+bool AppendFile::append(const char* data, size_t length) {
+    size_t written = 0;
+    
+    while (written < length) {
+#ifdef _WIN32
+        int result = ::_write(fd, data + written, (unsigned int)(length - written));
+#else
+        ssize_t result = ::write(fd, data + written, length - written);
+#endif
+        if (result <= 0) {
+            cerr << "Error. write to " << path << " failed" << endl;
+            truncateTo(size);
+            return false;
+        }
+        written += result;
+    }
+    
+    size += written;
+    return true;
+}
+
+// A failed append is cut back off, so the next one starts on a frame boundary instead of after a torn frame.
+void AppendFile::truncateTo(long long length) {
+#ifdef _WIN32
+    bool cut = ::_chsize_s(fd, length) == 0;
+#else
+    bool cut = ::ftruncate(fd, length) == 0;
+#endif
+    if (!cut) {
+        cerr << "Error. can not truncate " << path << " back to " << length << " bytes" << endl;
+    }
+}
+
+bool AppendFile::sync() {
+#ifdef _WIN32
+    return ::_commit(fd) == 0;
+#else
+    return ::fsync(fd) == 0;
+#endif
+}
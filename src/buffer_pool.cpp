@@ -0,0 +1,344 @@
+#include "../include/buffer_pool.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static bool seekTo(int fd, long long offset) {
+#ifdef _WIN32
+    return ::_lseeki64(fd, offset, SEEK_SET) == offset;
+#else
+    return ::lseek(fd, offset, SEEK_SET) == offset;
+#endif
+}
+
+BufferPool::BufferPool(size_t capacityBytes)
+    : fd(-1), fileSize(0), pageTable(256), clockHand(0), hits(0), misses(0), evictions(0), writebacks(0) {
+    capacityPages = max((size_t)1, capacityBytes / BUFFER_PAGE_SIZE);
+}
+
+BufferPool::~BufferPool() {
+    close();
+}
+
+bool BufferPool::open(const string& filepath) {
+    close();
+    path = filepath;
+    
+#ifdef _WIN32
+    fd = ::_open(path.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+#endif
+    if (fd < 0) {
+        cerr << "Error. can not open " << path << " for paging" << endl;
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close();
+        return false;
+    }
+    
+    fileSize = st.st_size;
+    return true;
+}
+
+// Dirty pages are written back; callers that replaced the file underneath close without relying on that.
+void BufferPool::close() {
+    if (fd < 0) {
+        return;
+    }
+    
+    flush();
+#ifdef _WIN32
+    ::_close(fd);
+#else
+    ::close(fd);
+#endif
+    fd = -1;
+    frames.clear();
+    pageTable.clear();
+    clockHand = 0;
+    fileSize = 0;
+}
+
+bool BufferPool::loadPage(Frame& frame, long long pageNo) {
+    long long start = pageNo * (long long)BUFFER_PAGE_SIZE;
+    size_t wanted = start < fileSize ? (size_t)min((long long)BUFFER_PAGE_SIZE, fileSize - start) : 0;
+    
+    frame.pageNo = pageNo;
+    frame.validBytes = 0;
+    frame.pinCount = 0;
+    frame.dirty = false;
+    frame.referenced = true;
+    
+    if (wanted == 0) {
+        return true;
+    }
+    if (!seekTo(fd, start)) {
+        return false;
+    }
+    
+    while (frame.validBytes < wanted) {
+#ifdef _WIN32
+        int got = ::_read(fd, frame.data.data() + frame.validBytes, (unsigned int)(wanted - frame.validBytes));
+#else
+        ssize_t got = ::read(fd, frame.data.data() + frame.validBytes, wanted - frame.validBytes);
+#endif
+        if (got <= 0) {
+            cerr << "Error. read of page " << pageNo << " from " << path << " failed" << endl;
+            return false;
+        }
+        frame.validBytes += got;
+    }
+    
+    return true;
+}
+
+bool BufferPool::writeBack(Frame& frame) {
+    if (!frame.dirty) {
+        return true;
+    }
+    if (!seekTo(fd, frame.pageNo * (long long)BUFFER_PAGE_SIZE)) {
+        return false;
+    }
+    
+    size_t written = 0;
+    while (written < frame.validBytes) {
+#ifdef _WIN32
+        int result = ::_write(fd, frame.data.data() + written, (unsigned int)(frame.validBytes - written));
+#else
+        ssize_t result = ::write(fd, frame.data.data() + written, frame.validBytes - written);
+#endif
+        if (result <= 0) {
+            cerr << "Error. write of page " << frame.pageNo << " to " << path << " failed" << endl;
+            return false;
+        }
+        written += result;
+    }
+    
+    frame.dirty = false;
+    writebacks++;
+    return true;
+}
+
+// Second-chance clock: a referenced frame has its bit cleared and is skipped once.
+int BufferPool::findVictim() {
+    if ((int)frames.size() < capacityPages) {
+        frames.push_back(Frame());
+        frames.back().data.resize(BUFFER_PAGE_SIZE);
+        return frames.size() - 1;
+    }
+    
+    for (size_t step = 0; step < 2 * frames.size(); step++) {
+        Frame& frame = frames[clockHand];
+        int index = clockHand;
+        clockHand = (clockHand + 1) % frames.size();
+    
+        if (frame.pinCount > 0) {
+            continue;
+        }
+        if (frame.referenced) {
+            frame.referenced = false;
+            continue;
+        }
+        if (!writeBack(frame)) {
+            return -1;
+        }
+    
+        pageTable.remove(frame.pageNo);
+        evictions++;
+        return index;
+    }
+    
+    return -1;
+}
+
+const char* BufferPool::pin(long long pageNo, size_t& validBytes) {
+    int* resident = pageTable.get(pageNo);
+    if (resident) {
+        Frame& frame = frames[*resident];
+        frame.pinCount++;
+        frame.referenced = true;
+        validBytes = frame.validBytes;
+        hits++;
+        return frame.data.data();
+    }
+    
+    misses++;
+    if (fd < 0) {
+        return nullptr;
+    }
+    
+    int index = findVictim();
+    if (index < 0) {
+        cerr << "Error. every buffer pool page is pinned" << endl;
+        return nullptr;
+    }
+    
+    Frame& frame = frames[index];
+    if (!loadPage(frame, pageNo)) {
+        frame.pageNo = -1;
+        return nullptr;
+    }
+    
+    pageTable.insert(pageNo, index);
+    frame.pinCount = 1;
+    validBytes = frame.validBytes;
+    return frame.data.data();
+}
+
+void BufferPool::unpin(long long pageNo, bool dirty) {
+    int* resident = pageTable.get(pageNo);
+    if (!resident) {
+        return;
+    }
+    
+    Frame& frame = frames[*resident];
+    if (frame.pinCount > 0) {
+        frame.pinCount--;
+    }
+    frame.dirty = frame.dirty || dirty;
+}
+
+bool BufferPool::read(long long offset, size_t length, string& out) {
+    out.resize(length);
+    size_t copied = 0;
+    
+    while (copied < length) {
+        long long pageNo = (offset + copied) / BUFFER_PAGE_SIZE;
+        size_t pageOffset = (offset + copied) % BUFFER_PAGE_SIZE;
+        size_t validBytes;
+    
+        const char* page = pin(pageNo, validBytes);
+        if (!page) {
+            return false;
+        }
+        if (pageOffset >= validBytes) {
+            unpin(pageNo);
+            return false;
+        }
+    
+        size_t take = min(length - copied, validBytes - pageOffset);
+        memcpy(&out[copied], page + pageOffset, take);
+        unpin(pageNo);
+        copied += take;
+    }
+    
+    return true;
+}
+
+// Writes land in the resident pages and are marked dirty; nothing reaches the file until flush or eviction.
+bool BufferPool::write(long long offset, const char* data, size_t length) {
+    size_t copied = 0;
+    
+    while (copied < length) {
+        long long pageNo = (offset + copied) / BUFFER_PAGE_SIZE;
+        size_t pageOffset = (offset + copied) % BUFFER_PAGE_SIZE;
+        size_t validBytes;
+    
+        if (!pin(pageNo, validBytes)) {
+            return false;
+        }
+    
+        Frame& frame = frames[*pageTable.get(pageNo)];
+        size_t take = min(length - copied, BUFFER_PAGE_SIZE - pageOffset);
+        memcpy(frame.data.data() + pageOffset, data + copied, take);
+        frame.validBytes = max(frame.validBytes, pageOffset + take);
+        unpin(pageNo, true);
+        copied += take;
+    }
+    
+    fileSize = max(fileSize, offset + (long long)length);
+    return true;
+}
+
+bool BufferPool::flush() {
+    vector<int> dirty;
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (frames[i].dirty) {
+            dirty.push_back(i);
+        }
+    }
+    
+    // Written in page order so a batch of appended pages goes out as one sequential run.
+    sort(dirty.begin(), dirty.end(), [this](int a, int b) {
+        return frames[a].pageNo < frames[b].pageNo;
+    });
+    
+    for (const auto& index : dirty) {
+        if (!writeBack(frames[index])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BufferPool::sync() {
+    if (fd < 0 || !flush()) {
+        return false;
+    }
+#ifdef _WIN32
+    return ::_commit(fd) == 0;
+#else
+    return ::fsync(fd) == 0;
+#endif
+}
+
+void BufferPool::shrink() {
+    vector<Frame> kept;
+    for (auto& frame : frames) {
+        if ((int)kept.size() < capacityPages || frame.pinCount > 0) {
+            kept.push_back(move(frame));
+            continue;
+        }
+        writeBack(frame);
+        evictions++;
+    }
+    
+    frames.swap(kept);
+    pageTable.clear();
+    for (size_t i = 0; i < frames.size(); i++) {
+        if (frames[i].pageNo >= 0) {
+            pageTable.insert(frames[i].pageNo, i);
+        }
+    }
+    clockHand = 0;
+}
+
+void BufferPool::setCapacity(size_t capacityBytes) {
+    capacityPages = max((size_t)1, capacityBytes / BUFFER_PAGE_SIZE);
+    if ((int)frames.size() > capacityPages) {
+        shrink();
+    }
+}
+
+BufferPoolStats BufferPool::getStats() const {
+    BufferPoolStats stats;
+    stats.hits = hits;
+    stats.misses = misses;
+    stats.evictions = evictions;
+    stats.writebacks = writebacks;
+    stats.residentPages = pageTable.getSize();
+    stats.capacityPages = capacityPages;
+    for (const auto& frame : frames) {
+        if (frame.pinCount > 0) {
+            stats.pinnedPages++;
+        }
+        if (frame.dirty) {
+            stats.dirtyPages++;
+        }
+    }
+    return stats;
+}
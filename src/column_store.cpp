@@ -0,0 +1,291 @@
+#include "../include/column_store.h"
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#define COLUMN_STORE_X86
+#include <immintrin.h>
+#endif
+
+#if defined(COLUMN_STORE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define COLUMN_STORE_AVX2
+#endif
+
+using namespace std;
+
+struct RangeBounds {
+    float minRating;
+    float maxRating;
+    float minPrice;
+    float maxPrice;
+};
+
+typedef int (*FilterKernel)(const float* ratings, const float* prices, int n, const RangeBounds& b, int* rows);
+
+// Every kernel writes matching row numbers to rows, or only counts them when rows is null.
+
+static int emitMask(unsigned mask, int base, int* rows, int found) {
+    while (mask) {
+        int bit = 0;
+        while (!(mask & (1u << bit))) {
+            bit++;
+        }
+        if (rows) {
+            rows[found] = base + bit;
+        }
+        found++;
+        mask &= mask - 1;
+    }
+    return found;
+}
+
+static int filterTail(const float* ratings, const float* prices, int start, int n, const RangeBounds& b, int* rows, int found) {
+    for (int i = start; i < n; i++) {
+        if (ratings[i] >= b.minRating && ratings[i] <= b.maxRating && prices[i] >= b.minPrice && prices[i] <= b.maxPrice) {
+            if (rows) {
+                rows[found] = i;
+            }
+            found++;
+        }
+    }
+    return found;
+}
+
+#ifndef COLUMN_STORE_X86
+static int filterScalar(const float* ratings, const float* prices, int n, const RangeBounds& b, int* rows) {
+    return filterTail(ratings, prices, 0, n, b, rows, 0);
+}
+#else
+static int filterSSE(const float* ratings, const float* prices, int n, const RangeBounds& b, int* rows) {
+    __m128 minR = _mm_set1_ps(b.minRating);
+    __m128 maxR = _mm_set1_ps(b.maxRating);
+    __m128 minP = _mm_set1_ps(b.minPrice);
+    __m128 maxP = _mm_set1_ps(b.maxPrice);
+    
+    int found = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 r = _mm_loadu_ps(ratings + i);
+        __m128 p = _mm_loadu_ps(prices + i);
+        __m128 hit = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(r, minR), _mm_cmple_ps(r, maxR)),
+                                _mm_and_ps(_mm_cmpge_ps(p, minP), _mm_cmple_ps(p, maxP)));
+        unsigned mask = _mm_movemask_ps(hit);
+        if (mask) {
+            found = emitMask(mask, i, rows, found);
+        }
+    }
+    
+    return filterTail(ratings, prices, i, n, b, rows, found);
+}
+#endif
+
+#ifdef COLUMN_STORE_AVX2
+__attribute__((target("avx2")))
+static int filterAVX2(const float* ratings, const float* prices, int n, const RangeBounds& b, int* rows) {
+    __m256 minR = _mm256_set1_ps(b.minRating);
+    __m256 maxR = _mm256_set1_ps(b.maxRating);
+    __m256 minP = _mm256_set1_ps(b.minPrice);
+    __m256 maxP = _mm256_set1_ps(b.maxPrice);
+    
+    int found = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 r = _mm256_loadu_ps(ratings + i);
+        __m256 p = _mm256_loadu_ps(prices + i);
+        __m256 hit = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(r, minR, _CMP_GE_OQ), _mm256_cmp_ps(r, maxR, _CMP_LE_OQ)),
+                                   _mm256_and_ps(_mm256_cmp_ps(p, minP, _CMP_GE_OQ), _mm256_cmp_ps(p, maxP, _CMP_LE_OQ)));
+        unsigned mask = _mm256_movemask_ps(hit);
+        if (mask) {
+            found = emitMask(mask, i, rows, found);
+        }
+    }
+    
+    return filterTail(ratings, prices, i, n, b, rows, found);
+}
+#endif
+
+static FilterKernel selectKernel(const char** name) {
+#ifdef COLUMN_STORE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        *name = "avx2";
+        return filterAVX2;
+    }
+#endif
+#ifdef COLUMN_STORE_X86
+    *name = "sse";
+    return filterSSE;
+#else
+    *name = "scalar";
+    return filterScalar;
+#endif
+}
+
+static const char* activeKernelName = "scalar";
+static const FilterKernel activeKernel = selectKernel(&activeKernelName);
+
+ColumnStore::ColumnStore() : rowOf(1000), liveRows(0) {}
+
+const char* ColumnStore::kernelName() {
+    return activeKernelName;
+}
+
+void ColumnStore::append(long long offset, float rating, float price) {
+    int* existing = rowOf.get(offset);
+    if (existing) {
+        if (isnan(ratings[*existing])) {
+            liveRows++;
+        }
+        ratings[*existing] = rating;
+        prices[*existing] = price;
+        return;
+    }
+    
+    rowOf.insert(offset, offsets.size());
+    ratings.push_back(rating);
+    prices.push_back(price);
+    offsets.push_back(offset);
+    liveRows++;
+}
+
+void ColumnStore::remove(long long offset) {
+    int* row = rowOf.get(offset);
+    if (!row || isnan(ratings[*row])) {
+        return;
+    }
+    
+    ratings[*row] = numeric_limits<float>::quiet_NaN();
+    prices[*row] = numeric_limits<float>::quiet_NaN();
+    liveRows--;
+}
+
+void ColumnStore::clear() {
+    ratings.clear();
+    prices.clear();
+    offsets.clear();
+    rowOf.clear();
+    liveRows = 0;
+}
+
+void ColumnStore::swap(ColumnStore& other) {
+    ratings.swap(other.ratings);
+    prices.swap(other.prices);
+    offsets.swap(other.offsets);
+    rowOf.swap(other.rowOf);
+    std::swap(liveRows, other.liveRows);
+}
+
+vector<long long> ColumnStore::filter(float minRating, float maxRating, float minPrice, float maxPrice) const {
+    RangeBounds bounds = {minRating, maxRating, minPrice, maxPrice};
+    
+    vector<int> rows(offsets.size());
+    int found = activeKernel(ratings.data(), prices.data(), offsets.size(), bounds, rows.data());
+    
+    vector<long long> result(found);
+    for (int i = 0; i < found; i++) {
+        result[i] = offsets[rows[i]];
+    }
+    return result;
+}
+
+int ColumnStore::count(float minRating, float maxRating, float minPrice, float maxPrice) const {
+    RangeBounds bounds = {minRating, maxRating, minPrice, maxPrice};
+    return activeKernel(ratings.data(), prices.data(), offsets.size(), bounds, nullptr);
+}
+
+bool ColumnStore::matches(long long offset, float minRating, float maxRating, float minPrice, float maxPrice) const {
+    const int* row = rowOf.get(offset);
+    if (!row) {
+        return false;
+    }
+    
+    float rating = ratings[*row];
+    float price = prices[*row];
+    return rating >= minRating && rating <= maxRating && price >= minPrice && price <= maxPrice;
+}
+
+bool ColumnStore::lookup(long long offset, float& rating, float& price) const {
+    const int* row = rowOf.get(offset);
+    if (!row || isnan(ratings[*row])) {
+        return false;
+    }
+    
+    rating = ratings[*row];
+    price = prices[*row];
+    return true;
+}
+
+void ColumnStore::aggregate(float minRating, float maxRating, float minPrice, float maxPrice, KeyStats<float>& ratingStats, KeyStats<float>& priceStats) const {
+    for (size_t i = 0; i < offsets.size(); i++) {
+        if (ratings[i] >= minRating && ratings[i] <= maxRating && prices[i] >= minPrice && prices[i] <= maxPrice) {
+            ratingStats.add(ratings[i]);
+            priceStats.add(prices[i]);
+        }
+    }
+}
+
+bool ColumnStore::save(const string& path, long long coveredLength) const {
+    ofstream file(path, ios::binary | ios::trunc);
+    if (!file) {
+        return false;
+    }
+    
+    int version = COLUMN_STORE_VERSION;
+    int count = offsets.size();
+    
+    file.write("FSCL", 4);
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    file.write(reinterpret_cast<const char*>(&coveredLength), sizeof(coveredLength));
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char*>(ratings.data()), count * sizeof(float));
+    file.write(reinterpret_cast<const char*>(prices.data()), count * sizeof(float));
+    file.write(reinterpret_cast<const char*>(offsets.data()), count * sizeof(long long));
+    
+    file.close();
+    return (bool)file;
+}
+
+bool ColumnStore::load(const string& path, long long coveredLength) {
+    ifstream file(path, ios::binary);
+    if (!file) {
+        return false;
+    }
+    
+    char magic[4];
+    int version;
+    long long storedLength;
+    int count;
+    
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&storedLength), sizeof(storedLength));
+    file.read(reinterpret_cast<char*>(&count), sizeof(count));
+    
+    if (!file || memcmp(magic, "FSCL", 4) != 0 || version != COLUMN_STORE_VERSION || storedLength != coveredLength || count < 0) {
+        return false;
+    }
+    
+    vector<float> loadedRatings(count);
+    vector<float> loadedPrices(count);
+    vector<long long> loadedOffsets(count);
+    file.read(reinterpret_cast<char*>(loadedRatings.data()), count * sizeof(float));
+    file.read(reinterpret_cast<char*>(loadedPrices.data()), count * sizeof(float));
+    file.read(reinterpret_cast<char*>(loadedOffsets.data()), count * sizeof(long long));
+    if (!file) {
+        return false;
+    }
+    
+    clear();
+    ratings = loadedRatings;
+    prices = loadedPrices;
+    offsets = loadedOffsets;
+    for (int i = 0; i < count; i++) {
+        rowOf.insert(offsets[i], i);
+        if (!isnan(ratings[i])) {
+            liveRows++;
+        }
+    }
+    return true;
+}
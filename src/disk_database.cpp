@@ -1,6 +1,15 @@
 #include "../include/disk_database.h"
 #include <iostream>
 #include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <filesystem>
+#include <chrono>
+#include <iterator>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <unordered_map>
 
 using namespace std;
 
@@ -10,327 +19,2496 @@ void DiskDatabase::writeString(ofstream& file, const string& str) {
     file.write(str.c_str(), len);
 }
 
-string DiskDatabase::readString(ifstream& file) {
-    int len;
-    file.read(reinterpret_cast<char*>(&len), sizeof(len));
+DiskDatabase::DiskDatabase(const string& filepath, StorageMode mode, int threads) : dataFilePath(filepath), indexFilePath(filepath + ".idx"), columnFilePath(filepath + ".cols"), storageMode(mode), durability(DURABILITY_NONE), compression(COMPRESSION_NONE), idIndex(1000), cuisineIndex(500), locationIndex(200), deadRecords(0), recordCache(DEFAULT_RECORD_CACHE_BYTES), blockCache(DEFAULT_BLOCK_CACHE_BYTES), nextId(1), writesSinceCheckpoint(0), compacting(false), fileId(0), rebuildThreads(0), indexState(INDEX_READY), stagedCutoff(0), indexBuildDone(false) 
+{
+    cout << "Data file: " << dataFilePath << endl;
+    setRebuildThreads(threads);
+    if (storageMode == STORAGE_PAGED) {
+        setMemoryBudget(DEFAULT_MEMORY_BUDGET_BYTES);
+    }
+    
+    ifstream testFile(dataFilePath, ios::binary);
+    if (testFile.good()) 
+    {
+        testFile.close();
+        cout << "data file found" << endl;
+    
+        checkDataFormat();
+        fileId = readDataFileId();
+    
+        if (loadIndexSnapshot()) {
+            cout << "Indexes loaded from snapshot" << endl;
+        } else {
+            scanRecordBounds();
+            indexState = INDEX_MISSING;
+            cout << "Indexes will be built on first use" << endl;
+        }
+    } 
+    else 
+    {
+        cout << "No existing file." << endl;
+    }
+    
+}
+
+DiskDatabase::~DiskDatabase() 
+{
+    if (compactionThread.joinable()) {
+        compactionThread.join();
+    }
+    if (indexState == INDEX_BUILDING) {
+        installStagedIndexes();
+    }
+    if (writesSinceCheckpoint > 0) {
+        saveIndexSnapshot();
+    }
+    //cout << "Database closed" << endl;
+}
+
+string DiskDatabase::generateId() 
+{
+    return "rest_" + to_string(nextId++);
+}
+
+uint64_t DiskDatabase::readDataFileId() {
+    ifstream file(dataFilePath, ios::binary);
+    char start[FILE_HEADER_SIZE + FRAME_HEADER_SIZE + sizeof(uint64_t)];
+    file.read(start, sizeof(start));
+    return readFileId(start, file.gcount());
+}
+
+void DiskDatabase::checkDataFormat() {
+    ifstream file(dataFilePath, ios::binary);
+    char header[FILE_HEADER_SIZE];
+    file.read(header, sizeof(header));
+    size_t got = file.gcount();
+    file.close();
+    
+    uint32_t version = fileFormatVersion(header, got);
+    if (got == 0 || version == DATA_FORMAT_VERSION) {
+        return;
+    }
+    
+    if (version == PLAIN_STRINGS_FORMAT_VERSION) {
+        migratePlainStrings();
+        return;
+    }
+    
+    if (got >= 4 && memcmp(header, DATA_FILE_MAGIC, 4) == 0) {
+        cerr << "Error. unsupported data format version in " << dataFilePath << endl;
+        return;
+    }
+    
+    migrateLegacyFile();
+}
+
+// Every new data file gets a fresh id, so an index snapshot of a file that has since been replaced is never reused.
+static uint64_t appendDataFileStart(string& out) {
+    random_device device;
+    uint64_t id = ((uint64_t)device() << 32) ^ device() ^ (uint64_t)chrono::steady_clock::now().time_since_epoch().count();
+    if (id == 0) {
+        id = 1;
+    }
+    appendFileHeader(out);
+    appendFileId(out, id);
+    return id;
+}
+
+static int restaurantIdNumber(const char* id, size_t length) {
+    string_view local = localId(string_view(id, length));
+    id = local.data();
+    length = local.size();
+    if (length <= 5 || memcmp(id, "rest_", 5) != 0) {
+        return 0;
+    }
+    return atoi(string(id + 5, length - 5).c_str());
+}
+
+// Defines any string the record introduces, then appends the record itself.
+static void appendCodedRestaurant(string& out, StringDictionary& dictionary, const Restaurant& r) {
+    vector<const string*> strings;
+    strings.push_back(&r.location);
+    for (const auto& cuisine : r.cuisineTypes) {
+        strings.push_back(&cuisine);
+    }
+    
+    for (const auto str : strings) {
+        if (dictionary.lookup(*str) == NO_STRING_CODE) {
+            string entry;
+            StringCode code = dictionary.nextCode();
+            encodeDictionaryEntry(code, *str, entry);
+            appendFrame(out, RECORD_DICTIONARY, entry);
+            dictionary.define(code, *str);
+        }
+    }
+    
+    string payload;
+    encodeRestaurant(r, dictionary, payload);
+    appendFrame(out, RECORD_RESTAURANT, payload);
+}
+
+bool DiskDatabase::migrateLegacyFile() {
+    cout << "Migrating legacy data file to framed format" << endl;
+    
+    ifstream in(dataFilePath, ios::binary);
+    string legacy((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+    
+    string migrated;
+    appendDataFileStart(migrated);
+    
+    StringDictionary strings;
+    ByteReader reader(legacy.data(), legacy.size());
+    int count = 0;
+    
+    while (reader.pos < legacy.size()) {
+        Restaurant r;
+        if (!decodeRestaurant(reader, r)) {
+            break;
+        }
+    
+        appendCodedRestaurant(migrated, strings, r);
+        count++;
+    }
+    
+    if (reader.pos < legacy.size()) {
+        cout << "Dropped " << (legacy.size() - reader.pos) << " unreadable trailing bytes" << endl;
+    }
+    
+    if (!replaceDataFile(migrated, ".legacy")) {
+        return false;
+    }
+    
+    cout << "Migrated " << count << " records, original kept at " << dataFilePath << ".legacy" << endl;
+    return true;
+}
+
+// Version 2 files kept every cuisine and location inline; frames are copied in order with the strings
+// moved into dictionary frames, and tombstones carried over unchanged.
+bool DiskDatabase::migratePlainStrings() {
+    cout << "Migrating data file to dictionary encoded strings" << endl;
+    
+    string migrated;
+    appendDataFileStart(migrated);
+    
+    StringDictionary strings;
+    RecordScanner scanner(dataFilePath);
+    FileOffset offset;
+    FrameHeader header;
+    const char* payload;
+    int count = 0;
+    
+    while (scanner.next(offset, header, payload)) {
+        ByteReader reader(payload, header.length);
+    
+        if (header.type == RECORD_TOMBSTONE) {
+            appendFrame(migrated, RECORD_TOMBSTONE, string(payload, header.length));
+            continue;
+        }
+    
+        Restaurant r;
+        if (header.type != RECORD_RESTAURANT || !decodeRestaurant(reader, r)) {
+            continue;
+        }
+    
+        appendCodedRestaurant(migrated, strings, r);
+        count++;
+    }
+    
+    FileOffset length = getDataFileLength();
+    if (scanner.isCorrupt() && scanner.position() < length) {
+        cout << "Dropped " << (length - scanner.position()) << " unreadable trailing bytes" << endl;
+    }
+    
+    if (!replaceDataFile(migrated, ".v2")) {
+        return false;
+    }
+    
+    cout << "Migrated " << count << " records with " << strings.size() << " distinct strings, "
+         << length << " -> " << migrated.size() << " bytes, original kept at " << dataFilePath << ".v2" << endl;
+    return true;
+}
+
+// The original is kept under the suffix; the index snapshot described it, so it is dropped.
+bool DiskDatabase::replaceDataFile(const string& contents, const string& backupSuffix) {
+    string tempPath = dataFilePath + ".migrating";
+    ofstream out(tempPath, ios::binary | ios::trunc);
+    out.write(contents.data(), contents.size());
+    out.close();
+    if (!out) {
+        cerr << "Error. can not write migrated data file" << endl;
+        return false;
+    }
+    
+    error_code ec;
+    filesystem::rename(dataFilePath, dataFilePath + backupSuffix, ec);
+    if (!ec) {
+        filesystem::rename(tempPath, dataFilePath, ec);
+    }
+    if (ec) {
+        cerr << "Error. can not replace data file: " << ec.message() << endl;
+        return false;
+    }
+    
+    filesystem::remove(indexFilePath, ec);
+    filesystem::remove(columnFilePath, ec);
+    return true;
+}
+
+// Paged mode appends through the buffer pool, so the tail page stays resident and is written once per batch.
+bool DiskDatabase::openAppendTarget() {
+    if (storageMode == STORAGE_PAGED) {
+        return bufferPool.isOpen() || bufferPool.open(dataFilePath);
+    }
+    return appendLog.isOpen() || appendLog.open(dataFilePath);
+}
+
+FileOffset DiskDatabase::appendPosition() {
+    return storageMode == STORAGE_PAGED ? bufferPool.getFileSize() : appendLog.getSize();
+}
+
+bool DiskDatabase::appendBytes(const string& bytes) {
+    if (storageMode == STORAGE_PAGED) {
+        return bufferPool.write(bufferPool.getFileSize(), bytes.data(), bytes.size());
+    }
+    return appendLog.append(bytes.data(), bytes.size());
+}
+
+bool DiskDatabase::syncAppends() {
+    return storageMode == STORAGE_PAGED ? bufferPool.sync() : appendLog.sync();
+}
+
+// prefix is already framed, typically the dictionary entries the payloads use; it goes out with the first write.
+vector<FileOffset> DiskDatabase::appendRecords(RecordType type, const vector<string>& payloads, bool sync, const string& prefix) {
+    vector<FileOffset> offsets;
+    
+    if (!openAppendTarget()) {
+        return offsets;
+    }
+    
+    FileOffset base = appendPosition();
+    bool syncEachRecord = durability == DURABILITY_WRITE;
+    
+    string buffer;
+    if (base == 0) {
+        fileId = appendDataFileStart(buffer);
+    }
+    buffer.append(prefix);
+    
+    for (const auto& payload : payloads) {
+        offsets.push_back(base + buffer.size());
+        appendFrame(buffer, type, payload);
+    
+        if (syncEachRecord) {
+            if (!appendBytes(buffer) || !syncAppends()) {
+                cerr << "Error. durable write failed for " << dataFilePath << endl;
+                offsets.clear();
+                return offsets;
+            }
+            base += buffer.size();
+            buffer.clear();
+        }
+    }
+    
+    if (!buffer.empty() && !appendBytes(buffer)) {
+        offsets.clear();
+        return offsets;
+    }
+    
+    // Scans, rebuilds and compaction read the file directly, so dirty pages never outlive the batch.
+    if (storageMode == STORAGE_PAGED && !bufferPool.flush()) {
+        cerr << "Error. page write-back failed for " << dataFilePath << endl;
+        offsets.clear();
+        return offsets;
+    }
+    
+    if ((sync || durability == DURABILITY_BATCH) && !syncAppends()) {
+        cerr << "Error. fsync failed for " << dataFilePath << endl;
+        offsets.clear();
+        return offsets;
+    }
+    
+    //cout << "Written to disk at offset: " << offsets[0] << endl;
+    
+    return offsets;
+}
+
+// Strings the batch introduces go out as dictionary frames ahead of the records, in the same write, so every
+// record follows the codes it uses and the batch costs one write and at most one fsync.
+vector<FileOffset> DiskDatabase::writeRestaurantsToDisk(const vector<Restaurant>& batch, bool sync) {
+    if (!openAppendTarget()) {
+        return vector<FileOffset>();
+    }
+    
+    vector<string> added;
+    HashTable<string, bool> pending(64);
+    for (const auto& r : batch) {
+        vector<const string*> strings;
+        strings.push_back(&r.location);
+        for (const auto& cuisine : r.cuisineTypes) {
+            strings.push_back(&cuisine);
+        }
+        for (const auto str : strings) {
+            if (dictionary.lookup(*str) == NO_STRING_CODE && !pending.contains(*str)) {
+                pending.insert(*str, true);
+                added.push_back(*str);
+            }
+        }
+    }
+    
+    StringCode firstAdded = dictionary.nextCode();
+    string entries;
+    for (const auto& str : added) {
+        string entry;
+        encodeDictionaryEntry(dictionary.nextCode(), str, entry);
+        appendFrame(entries, RECORD_DICTIONARY, entry);
+        dictionary.define(dictionary.nextCode(), str);
+    }
+    
+    vector<string> payloads(batch.size());
+    for (size_t i = 0; i < batch.size(); i++) {
+        encodeRestaurant(batch[i], dictionary, payloads[i]);
+    }
+    
+    FileOffset before = appendPosition();
+    vector<FileOffset> offsets;
+    if (compression == COMPRESSION_BLOCKS && batch.size() >= MIN_BLOCK_RECORDS) {
+        offsets = appendBlocks(batch, payloads, sync, entries);
+    } else {
+        offsets = appendRecords(RECORD_RESTAURANT, payloads, sync, entries);
+    }
+    
+    // Once any of the write reached the file the new entries are on disk and their codes stay taken.
+    if (offsets.empty() && appendPosition() == before) {
+        dictionary.truncate(firstAdded);
+    }
+    return offsets;
+}
+
+// Packs the batch into blocks of about COMPRESSED_BLOCK_BYTES of frames; each record's offset is its block's plus its slot.
+vector<FileOffset> DiskDatabase::appendBlocks(const vector<Restaurant>& batch, const vector<string>& payloads, bool sync, const string& prefix) {
+    vector<string> blocks;
+    vector<uint32_t> counts;
+    string frames;
+    uint32_t records = 0;
+    int maxIdNumber = 0;
+    
+    for (size_t i = 0; i < payloads.size(); i++) {
+        appendFrame(frames, RECORD_RESTAURANT, payloads[i]);
+        records++;
+        const string& id = batch[i].restaurantId;
+        maxIdNumber = max(maxIdNumber, restaurantIdNumber(id.data(), id.size()));
+    
+        if (frames.size() >= COMPRESSED_BLOCK_BYTES || i + 1 == payloads.size()) {
+            blocks.push_back(string());
+            encodeBlock(frames, records, maxIdNumber, blocks.back());
+            counts.push_back(records);
+            frames.clear();
+            records = 0;
+            maxIdNumber = 0;
+        }
+    }
+    
+    vector<FileOffset> offsets;
+    vector<FileOffset> blockOffsets = appendRecords(RECORD_BLOCK, blocks, sync, prefix);
+    for (size_t b = 0; b < blockOffsets.size(); b++) {
+        blockIndex.add(blockOffsets[b], counts[b]);
+        for (uint32_t slot = 0; slot < counts[b]; slot++) {
+            offsets.push_back(blockOffsets[b] + slot);
+        }
+    }
+    return offsets;
+}
+
+FileOffset DiskDatabase::writeRestaurantToDisk(const Restaurant& r) {
+    vector<FileOffset> offsets = writeRestaurantsToDisk(vector<Restaurant>{r}, false);
+    return offsets.empty() ? -1 : offsets[0];
+}
+
+bool DiskDatabase::ensureMapped(FileOffset offset) {
+    if (!mappedData.isOpen() || offset >= (FileOffset)mappedData.getSize()) {
+        bool mapped = mappedData.isOpen() ? mappedData.remap() : mappedData.open(dataFilePath);
+        if (!mapped) {
+            cerr << "Error. cannot map file" << endl;
+            return false;
+        }
+    }
+    
+    return offset >= 0 && offset < (FileOffset)mappedData.getSize();
+}
+
+bool DiskDatabase::mappedPayload(FileOffset offset, ByteReader& reader) {
+    FrameHeader header;
+    if (!ensureMapped(offset) || !readFrameHeader(mappedData.getData(), mappedData.getSize(), offset, header)) {
+        return false;
+    }
+    
+    size_t payloadStart = offset + FRAME_HEADER_SIZE;
+    if (header.type != RECORD_RESTAURANT || mappedData.getSize() - payloadStart < header.length) {
+        return false;
+    }
+    
+    reader = ByteReader(mappedData.getData() + payloadStart, header.length);
+    return true;
+}
+
+Restaurant DiskDatabase::readRestaurantFromMapping(FileOffset offset) {
+    Restaurant r;
+    ByteReader reader(nullptr, 0);
+    if (mappedPayload(offset, reader)) {
+        decodeRestaurant(reader, dictionary, r);
+    }
+    return r;
+}
+
+static bool blockRecord(const DecodedBlock& block, uint32_t slot, ByteReader& reader) {
+    size_t pos = slot < block.slots.size() ? block.slots[slot] : block.frames.size();
+    FrameHeader header;
+    const char* payload;
+    if (!nextBlockFrame(block.frames, pos, header, payload)) {
+        return false;
+    }
+    
+    reader = ByteReader(payload, header.length);
+    return header.type == RECORD_RESTAURANT;
+}
+
+// Decompressed blocks are cached, so records read together from one block cost a single decompression.
+// Like plain point reads, this path skips the checksum; scans and index builds verify every block.
+shared_ptr<const DecodedBlock> DiskDatabase::loadBlock(FileOffset blockOffset) {
+    shared_ptr<const DecodedBlock> block;
+    if (blockCache.get(blockOffset, block)) {
+        return block;
+    }
+    
+    FrameHeader header;
+    string payload;
+    if (storageMode == STORAGE_MMAP) {
+        if (!ensureMapped(blockOffset) || !readFrameHeader(mappedData.getData(), mappedData.getSize(), blockOffset, header) || mappedData.getSize() - blockOffset - FRAME_HEADER_SIZE < header.length) {
+            return block;
+        }
+        payload.assign(mappedData.getData() + blockOffset + FRAME_HEADER_SIZE, header.length);
+    } else if (storageMode == STORAGE_PAGED) {
+        if (!bufferPool.isOpen() && !bufferPool.open(dataFilePath)) {
+            return block;
+        }
+        if (!bufferPool.read(blockOffset, FRAME_HEADER_SIZE, payload) || !readFrameHeader(payload.data(), payload.size(), 0, header) || !bufferPool.read(blockOffset + FRAME_HEADER_SIZE, header.length, payload)) {
+            return block;
+        }
+    } else {
+        ifstream file(dataFilePath, ios::binary);
+        file.seekg(blockOffset);
+        char headerBytes[FRAME_HEADER_SIZE];
+        file.read(headerBytes, sizeof(headerBytes));
+        if (!file || !readFrameHeader(headerBytes, sizeof(headerBytes), 0, header)) {
+            return block;
+        }
+        payload.resize(header.length);
+        file.read(&payload[0], header.length);
+        if (!file) {
+            return block;
+        }
+    }
+    
+    shared_ptr<DecodedBlock> decoded = make_shared<DecodedBlock>();
+    bool valid = header.type == RECORD_BLOCK && decodeBlock(payload.data(), payload.size(), decoded->frames);
+    
+    size_t pos = 0;
+    FrameHeader inner;
+    const char* innerPayload;
+    while (valid && pos < decoded->frames.size()) {
+        decoded->slots.push_back(pos);
+        valid = nextBlockFrame(decoded->frames, pos, inner, innerPayload);
+    }
+    
+    if (!valid) {
+        cerr << "Error. unreadable compressed block at offset " << blockOffset << endl;
+        return block;
+    }
+    
+    block = decoded;
+    blockCache.put(blockOffset, block, decoded->frames.capacity() + decoded->slots.capacity() * sizeof(uint32_t));
+    return block;
+}
+
+Restaurant DiskDatabase::readRestaurantFromBlock(FileOffset offset) {
+    Restaurant r;
+    FileOffset blockOffset;
+    uint32_t slot;
+    if (!blockIndex.find(offset, blockOffset, slot)) {
+        return r;
+    }
+    
+    shared_ptr<const DecodedBlock> block = loadBlock(blockOffset);
+    ByteReader reader(nullptr, 0);
+    if (block && blockRecord(*block, slot, reader)) {
+        decodeRestaurant(reader, dictionary, r);
+    }
+    return r;
+}
+
+vector<RestaurantView> DiskDatabase::readViews(const vector<FileOffset>& offsets) {
+    FileOffset maxOffset = 0;
+    for (const auto& offset : offsets) {
+        maxOffset = max(maxOffset, offset);
+    }
+    
+    vector<RestaurantView> views;
+    if (offsets.empty() || !ensureMapped(maxOffset)) {
+        return views;
+    }
+    
+    views.reserve(offsets.size());
+    for (const auto& offset : offsets) {
+        ByteReader reader(nullptr, 0);
+        RestaurantView view;
+        FileOffset blockOffset;
+        uint32_t slot;
+    
+        if (blockIndex.find(offset, blockOffset, slot)) {
+            shared_ptr<const DecodedBlock> block = loadBlock(blockOffset);
+            if (block && blockRecord(*block, slot, reader) && view.parse(reader, dictionary)) {
+                view.source = block;
+                views.push_back(view);
+            }
+            continue;
+        }
+    
+        if (mappedPayload(offset, reader) && view.parse(reader, dictionary)) {
+            view.source = mappedData.getRegion();
+            views.push_back(view);
+        }
+    }
+    
+    return views;
+}
+
+static size_t recordFootprint(const Restaurant& r) {
+    size_t bytes = sizeof(Restaurant) + r.restaurantId.capacity() + r.name.capacity() + r.location.capacity() + r.notes.capacity();
+    for (const auto& cuisine : r.cuisineTypes) {
+        bytes += sizeof(string) + cuisine.capacity();
+    }
+    for (const auto& dish : r.dishes) {
+        bytes += sizeof(Dish) + dish.dishName.capacity();
+    }
+    return bytes;
+}
+
+Restaurant DiskDatabase::readRestaurantFromDisk(FileOffset offset) {
+    Restaurant r;
+    if (recordCache.get(offset, r)) {
+        return r;
+    }
+    
+    if (blockIndex.contains(offset)) {
+        r = readRestaurantFromBlock(offset);
+    } else if (storageMode == STORAGE_MMAP) {
+        r = readRestaurantFromMapping(offset);
+    } else if (storageMode == STORAGE_PAGED) {
+        r = readRestaurantFromPool(offset);
+    } else {
+        r = readRestaurantFromStream(offset);
+    }
+    
+    if (!r.restaurantId.empty()) {
+        recordCache.put(offset, r, recordFootprint(r));
+    }
+    
+    return r;
+}
+
+Restaurant DiskDatabase::readRestaurantFromStream(FileOffset offset) {
+    Restaurant r;
+    
+    ifstream file(dataFilePath, ios::binary);
+    if (!file) {
+        cerr << "Error. cannot open file" << endl;
+        return r;
+    }
+    
+    file.seekg(offset);
+    
+    char headerBytes[FRAME_HEADER_SIZE];
+    file.read(headerBytes, sizeof(headerBytes));
+    
+    FrameHeader header;
+    if (!file || !readFrameHeader(headerBytes, sizeof(headerBytes), 0, header) || header.type != RECORD_RESTAURANT) {
+        return r;
+    }
+    
+    string payload(header.length, '\0');
+    file.read(&payload[0], header.length);
+    file.close();
+    
+    ByteReader reader(payload.data(), file ? payload.size() : 0);
+    decodeRestaurant(reader, dictionary, r);
+    
+    return r;
+}
+
+Restaurant DiskDatabase::readRestaurantFromPool(FileOffset offset) {
+    Restaurant r;
+    if (!bufferPool.isOpen() && !bufferPool.open(dataFilePath)) {
+        return r;
+    }
+    
+    string bytes;
+    FrameHeader header;
+    if (!bufferPool.read(offset, FRAME_HEADER_SIZE, bytes) || !readFrameHeader(bytes.data(), bytes.size(), 0, header) || header.type != RECORD_RESTAURANT) {
+        return r;
+    }
+    
+    if (!bufferPool.read(offset + FRAME_HEADER_SIZE, header.length, bytes)) {
+        return r;
+    }
+    
+    ByteReader reader(bytes.data(), bytes.size());
+    decodeRestaurant(reader, dictionary, r);
+    return r;
+}
+
+// Cache misses are read in file order, with records close together merged into one read, then put back in request order.
+vector<Restaurant> DiskDatabase::fetchRestaurants(const vector<FileOffset>& offsets) {
+    vector<Restaurant> results(offsets.size());
+    vector<pair<FileOffset, size_t>> misses;
+    
+    for (size_t i = 0; i < offsets.size(); i++) {
+        if (!recordCache.get(offsets[i], results[i])) {
+            misses.push_back(make_pair(offsets[i], i));
+        }
+    }
+    
+    if (misses.empty()) {
+        return results;
+    }
+    
+    sort(misses.begin(), misses.end());
+    
+    // Block misses come out in file order too, so each block is decompressed once per call.
+    if (blockIndex.size() > 0) {
+        vector<pair<FileOffset, size_t>> fileMisses;
+        for (const auto& miss : misses) {
+            if (!blockIndex.contains(miss.first)) {
+                fileMisses.push_back(miss);
+                continue;
+            }
+            results[miss.second] = readRestaurantFromBlock(miss.first);
+            if (!results[miss.second].restaurantId.empty()) {
+                recordCache.put(miss.first, results[miss.second], recordFootprint(results[miss.second]));
+            }
+        }
+        misses.swap(fileMisses);
+    }
+    
+    if (storageMode != STORAGE_STREAM) {
+        for (const auto& miss : misses) {
+            results[miss.second] = storageMode == STORAGE_MMAP ? readRestaurantFromMapping(miss.first) : readRestaurantFromPool(miss.first);
+            if (!results[miss.second].restaurantId.empty()) {
+                recordCache.put(miss.first, results[miss.second], recordFootprint(results[miss.second]));
+            }
+        }
+        return results;
+    }
+    
+    ifstream file(dataFilePath, ios::binary);
+    if (!file) {
+        cerr << "Error. cannot open file" << endl;
+        return results;
+    }
+    
+    FileOffset fileLength = getDataFileLength();
+    string buffer;
+    size_t first = 0;
+    
+    while (first < misses.size()) {
+        // Frame lengths are unknown until read, so each run reserves a generous tail past its last start.
+        FileOffset runStart = misses[first].first;
+        size_t last = first;
+        while (last + 1 < misses.size() && misses[last + 1].first - misses[last].first <= COALESCE_GAP_BYTES && misses[last + 1].first - runStart < MAX_COALESCED_READ) {
+            last++;
+        }
+    
+        FileOffset runEnd = min(fileLength, misses[last].first + COALESCE_GAP_BYTES);
+        buffer.resize(runEnd - runStart);
+        file.clear();
+        file.seekg(runStart);
+        file.read(&buffer[0], buffer.size());
+        size_t got = file.gcount();
+    
+        for (size_t i = first; i <= last; i++) {
+            FileOffset offset = misses[i].first;
+            size_t pos = offset - runStart;
+            FrameHeader header;
+            Restaurant& r = results[misses[i].second];
+    
+            if (!readFrameHeader(buffer.data(), got, pos, header) || header.type != RECORD_RESTAURANT) {
+                continue;
+            }
+    
+            if (pos + FRAME_HEADER_SIZE + header.length <= got) {
+                ByteReader reader(buffer.data() + pos + FRAME_HEADER_SIZE, header.length);
+                decodeRestaurant(reader, dictionary, r);
+            } else {
+                r = readRestaurantFromStream(offset);
+            }
+    
+            if (!r.restaurantId.empty()) {
+                recordCache.put(offset, r, recordFootprint(r));
+            }
+        }
+    
+        first = last + 1;
+    }
+    
+    return results;
+}
+
+void DiskDatabase::indexTenant(const string& key, FileOffset offset) {
+    string_view tenant = tenantOf(key);
+    if (!tenant.empty()) {
+        tenantIndex.insertSorted(string(tenant), offset);
+    }
+}
+
+void DiskDatabase::indexRestaurant(const Restaurant& r, FileOffset offset) {
+    FileOffset* existing = idIndex.get(r.restaurantId);
+    if (existing && *existing != offset) {
+        FileOffset oldOffset = *existing;
+        unindexRestaurant(readRestaurantFromDisk(oldOffset), oldOffset);
+    }
+    
+    ratingIndex.insert(r.overallRating, offset);
+    priceIndex.insert(r.averagePrice, offset);
+    idIndex.insert(r.restaurantId, offset);
+    indexTenant(r.restaurantId, offset);
+    columns.append(offset, r.overallRating, r.averagePrice);
+    
+    for (const auto& cuisine : r.cuisineTypes) {
+        cuisineIndex.insert(dictionary.lookup(cuisine), offset);
+    }
+    
+    locationIndex.insert(dictionary.lookup(r.location), offset);
+    
+    string_view local = localId(r.restaurantId);
+    if (local.compare(0, 5, "rest_") == 0) {
+        int num = atoi(string(local.substr(5)).c_str());
+        if (num >= nextId) {
+            nextId = num + 1;
+        }
+    }
+}
+
+void DiskDatabase::unindexRestaurant(const Restaurant& r, FileOffset offset) {
+    FileOffset* current = idIndex.get(r.restaurantId);
+    if (current && *current == offset) {
+        idIndex.remove(r.restaurantId);
+    }
+    
+    // The column row holds the keys this offset was indexed under, even if the record no longer reads back.
+    float rating = r.overallRating;
+    float price = r.averagePrice;
+    columns.lookup(offset, rating, price);
+    ratingIndex.remove(rating, offset);
+    priceIndex.remove(price, offset);
+    
+    for (const auto& cuisine : r.cuisineTypes) {
+        cuisineIndex.remove(dictionary.lookup(cuisine), offset);
+    }
+    
+    locationIndex.remove(dictionary.lookup(r.location), offset);
+    
+    string_view tenant = tenantOf(r.restaurantId);
+    if (!tenant.empty()) {
+        tenantIndex.remove(string(tenant), offset);
+    }
+    
+    deadRecords++;
+    columns.remove(offset);
+    recordCache.erase(offset);
+}
+
+void DiskDatabase::applyTombstone(const string& id) {
+    FileOffset* existing = idIndex.get(id);
+    if (existing) {
+        FileOffset oldOffset = *existing;
+        unindexRestaurant(readRestaurantFromDisk(oldOffset), oldOffset);
+    }
+}
+
+bool DiskDatabase::isLiveRecord(const string& id, FileOffset offset) {
+    FileOffset* current = idIndex.get(id);
+    return current && *current == offset;
+}
+
+void DiskDatabase::clearIndexes() {
+    ratingIndex.clear();
+    priceIndex.clear();
+    idIndex.clear();
+    cuisineIndex.clear();
+    locationIndex.clear();
+    tenantIndex.clear();
+    deadRecords = 0;
+    columns.clear();
+}
+
+void DiskDatabase::rebuildColumns() {
+    columns.clear();
+    
+    HashTable<FileOffset, float> priceOf(1000);
+    for (const auto& entry : priceIndex.getAllPairs()) {
+        priceOf.insert(entry.second, entry.first);
+    }
+    
+    vector<pair<float, FileOffset>> ratings = ratingIndex.getAllPairs();
+    sort(ratings.begin(), ratings.end(), [](const pair<float, FileOffset>& a, const pair<float, FileOffset>& b) {
+        return a.second < b.second;
+    });
+    
+    for (const auto& entry : ratings) {
+        float* price = priceOf.get(entry.second);
+        if (price) {
+            columns.append(entry.second, entry.first, *price);
+        }
+    }
+}
+
+void DiskDatabase::rebuildIndexes(FileOffset startOffset) {
+    RecordScanner scanner(dataFilePath, max(startOffset, (FileOffset)FILE_HEADER_SIZE));
+    if (!scanner.isOpen()) {
+        return;
+    }
+    
+    FileOffset offset;
+    FrameHeader header;
+    const char* payload;
+    
+    while (scanner.next(offset, header, payload)) {
+        ByteReader reader(payload, header.length);
+    
+        if (offset == scanner.currentBlock()) {
+            blockIndex.add(offset, scanner.currentBlockRecords());
+        }
+    
+        if (header.type == RECORD_TOMBSTONE) {
+            applyTombstone(reader.readString());
+            continue;
+        }
+    
+        if (header.type == RECORD_DICTIONARY) {
+            StringCode code;
+            string value;
+            if (!decodeDictionaryEntry(reader, code, value) || !dictionary.define(code, value)) {
+                cerr << "Warning. inconsistent dictionary entry at offset " << offset << endl;
+            }
+            continue;
+        }
+    
+        if (header.type != RECORD_RESTAURANT) {
+            continue;
+        }
+    
+        Restaurant r;
+        if (!decodeRestaurant(reader, dictionary, r)) {
+            continue;
+        }
+    
+        indexRestaurant(r, offset);
+    }
+    
+    if (scanner.isCorrupt()) {
+        recoverTornTail(scanner.position());
+    }
+    
+    //cout << "Indexing done" << endl;
+}
+
+struct RebuildEntry {
+    FileOffset offset;
+    bool tombstone;
+    Restaurant record;
+};
+
+struct RebuildChunk {
+    size_t firstFrame;
+    size_t endFrame;
+    unordered_map<string, RebuildEntry> latest;
+    int maxId;
+    FileOffset corruptAt;
+};
+
+static void decodeRebuildEntry(FileOffset offset, const FrameHeader& header, const char* payload, const StringDictionary& dictionary, RebuildChunk& chunk) {
+    ByteReader reader(payload, header.length);
+    RebuildEntry entry;
+    entry.offset = offset;
+    entry.tombstone = header.type == RECORD_TOMBSTONE;
+    
+    if (entry.tombstone) {
+        string id = reader.readString();
+        chunk.latest[id] = entry;
+        return;
+    }
+    
+    if (header.type != RECORD_RESTAURANT || !decodeRestaurant(reader, dictionary, entry.record)) {
+        return;
+    }
+    
+    const string& id = entry.record.restaurantId;
+    chunk.maxId = max(chunk.maxId, restaurantIdNumber(id.data(), id.size()));
+    chunk.latest[id] = entry;
+}
+
+static void decodeRebuildChunk(const char* data, const vector<FileOffset>& frames, const StringDictionary& dictionary, RebuildChunk& chunk) {
+    string block;
+    
+    for (size_t i = chunk.firstFrame; i < chunk.endFrame; i++) {
+        FileOffset offset = frames[i];
+        FrameHeader header;
+        readFrameHeader(data, offset + FRAME_HEADER_SIZE, offset, header);
+        const char* payload = data + offset + FRAME_HEADER_SIZE;
+    
+        if (crc32(payload, header.length) != header.checksum) {
+            chunk.corruptAt = offset;
+            return;
+        }
+    
+        if (header.type != RECORD_BLOCK) {
+            decodeRebuildEntry(offset, header, payload, dictionary, chunk);
+            continue;
+        }
+    
+        BlockHeader blockHeader;
+        if (!readBlockHeader(payload, header.length, blockHeader) || !decodeBlock(payload, header.length, block)) {
+            chunk.corruptAt = offset;
+            return;
+        }
+    
+        size_t pos = 0;
+        FrameHeader inner;
+        const char* innerPayload;
+        for (uint32_t slot = 0; slot < blockHeader.records; slot++) {
+            if (!nextBlockFrame(block, pos, inner, innerPayload)) {
+                chunk.corruptAt = offset;
+                return;
+            }
+            decodeRebuildEntry(offset + slot, inner, innerPayload, dictionary, chunk);
+        }
+        if (pos != block.size()) {
+            chunk.corruptAt = offset;
+            return;
+        }
+    }
+}
+
+// Entries from a snapshot, a scan or a compaction are normally in order already; anything else is sorted
+// first so the bulk load always gets what it requires.
+static void loadSortedTree(BPlusTree<float, FileOffset>& tree, vector<pair<float, FileOffset>>& entries) {
+    if (!is_sorted(entries.begin(), entries.end())) {
+        sort(entries.begin(), entries.end());
+    }
+    entries.erase(unique(entries.begin(), entries.end()), entries.end());
+    tree.bulkLoad(entries.begin(), entries.end());
+}
+
+// Frame boundaries come from a header-only walk, which also loads the dictionary; chunks are then CRC-checked and decoded on
+// separate threads, keeping only the last record or tombstone per id, and merged in file order.
+// Touches nothing but the file and the given set, so it can run without holding dbMutex.
+static void buildIndexSet(const string& path, FileOffset cutoff, int threads, IndexSet& out) {
+    auto start = chrono::steady_clock::now();
+    out.validEnd = cutoff;
+    
+    MappedFile mapping;
+    if (!mapping.open(path)) {
+        return;
+    }
+    
+    const char* data = mapping.getData();
+    FileOffset length = min((FileOffset)mapping.getSize(), cutoff);
+    
+    vector<FileOffset> frames;
+    vector<FileOffset> dictionaryFrames;
+    FileOffset pos = FILE_HEADER_SIZE;
+    FrameHeader header;
+    while (readFrameHeader(data, length, pos, header) && pos + (FileOffset)(FRAME_HEADER_SIZE + header.length) <= length) {
+        if (header.type == RECORD_DICTIONARY) {
+            const char* payload = data + pos + FRAME_HEADER_SIZE;
+            ByteReader reader(payload, header.length);
+            StringCode code;
+            string value;
+            if (crc32(payload, header.length) != header.checksum || !decodeDictionaryEntry(reader, code, value) || !out.dictionary.define(code, value)) {
+                break;
+            }
+            dictionaryFrames.push_back(pos);
+        } else {
+            frames.push_back(pos);
+        }
+        pos += FRAME_HEADER_SIZE + header.length;
+    }
+    out.validEnd = pos;
+    
+    size_t chunkCount = min((size_t)threads, frames.size() / MIN_FRAMES_PER_CHUNK + 1);
+    vector<RebuildChunk> chunks(chunkCount);
+    vector<thread> workers;
+    for (size_t c = 0; c < chunkCount; c++) {
+        chunks[c].firstFrame = frames.size() * c / chunkCount;
+        chunks[c].endFrame = frames.size() * (c + 1) / chunkCount;
+        chunks[c].maxId = 0;
+        chunks[c].corruptAt = -1;
+        workers.push_back(thread(decodeRebuildChunk, data, cref(frames), cref(out.dictionary), ref(chunks[c])));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    auto decoded = chrono::steady_clock::now();
+    
+    unordered_map<string, RebuildEntry> latest;
+    for (auto& chunk : chunks) {
+        for (auto& entry : chunk.latest) {
+            latest[entry.first] = move(entry.second);
+        }
+        out.maxId = max(out.maxId, chunk.maxId);
+    
+        if (chunk.corruptAt >= 0) {
+            out.validEnd = chunk.corruptAt;
+            break;
+        }
+    }
+    
+    // Strings defined past a corrupt record go with the rest of the truncated tail.
+    out.dictionary.truncate(lower_bound(dictionaryFrames.begin(), dictionaryFrames.end(), out.validEnd) - dictionaryFrames.begin());
+    
+    vector<RebuildEntry*> live;
+    live.reserve(latest.size());
+    for (auto& entry : latest) {
+        if (!entry.second.tombstone) {
+            live.push_back(&entry.second);
+        }
+    }
+    sort(live.begin(), live.end(), [](const RebuildEntry* a, const RebuildEntry* b) {
+        return a->offset < b->offset;
+    });
+    
+    // Every entry is the only live version of its id, so the superseding checks in indexRestaurant are
+    // skipped and the multi-value indexes take whole lists instead of deduplicating value by value.
+    unordered_map<StringCode, vector<FileOffset>> cuisines;
+    unordered_map<StringCode, vector<FileOffset>> locations;
+    unordered_map<string, vector<FileOffset>> tenants;
+    vector<pair<float, FileOffset>> ratings;
+    vector<pair<float, FileOffset>> prices;
+    ratings.reserve(live.size());
+    prices.reserve(live.size());
+    for (const auto entry : live) {
+        const Restaurant& r = entry->record;
+        ratings.push_back(make_pair(r.overallRating, entry->offset));
+        prices.push_back(make_pair(r.averagePrice, entry->offset));
+        out.idIndex.insert(r.restaurantId, entry->offset);
+        out.columns.append(entry->offset, r.overallRating, r.averagePrice);
+        for (const auto& cuisine : r.cuisineTypes) {
+            vector<FileOffset>& offsets = cuisines[out.dictionary.lookup(cuisine)];
+            if (offsets.empty() || offsets.back() != entry->offset) {
+                offsets.push_back(entry->offset);
+            }
+        }
+        locations[out.dictionary.lookup(r.location)].push_back(entry->offset);
+        string_view tenant = tenantOf(r.restaurantId);
+        if (!tenant.empty()) {
+            tenants[string(tenant)].push_back(entry->offset);
+        }
+    }
+    for (const auto& entry : cuisines) {
+        out.cuisineIndex.insertAll(entry.first, entry.second);
+    }
+    for (const auto& entry : locations) {
+        out.locationIndex.insertAll(entry.first, entry.second);
+    }
+    for (const auto& entry : tenants) {
+        out.tenantIndex.insertAll(entry.first, entry.second);
+    }
+    loadSortedTree(out.ratingIndex, ratings);
+    loadSortedTree(out.priceIndex, prices);
+    
+    auto indexed = chrono::steady_clock::now();
+    cout << "Built indexes for " << live.size() << " restaurants: " << frames.size() << " records decoded in "
+         << chrono::duration<double, milli>(decoded - start).count() << " ms across " << chunkCount << (chunkCount == 1 ? " chunk" : " chunks")
+         << ", indexed in " << chrono::duration<double, milli>(indexed - decoded).count() << " ms" << endl;
+    
+    TreeMemoryStats ratingMemory = out.ratingIndex.getMemoryStats();
+    TreeMemoryStats priceMemory = out.priceIndex.getMemoryStats();
+    cout << "Rating tree " << ratingMemory.reservedBytes() / 1024 << " KB in " << ratingMemory.liveNodes() << " nodes, price tree "
+         << priceMemory.reservedBytes() / 1024 << " KB in " << priceMemory.liveNodes() << " nodes" << endl;
+}
+
+// Header-only pass run on open instead of a full rebuild: finds the id counter and cuts a torn tail
+// so appends can start before any index exists. Checksums are left to the index build, except on
+// dictionary frames: appends need the full dictionary before any index exists.
+void DiskDatabase::scanRecordBounds() {
+    MappedFile mapping;
+    if (!mapping.open(dataFilePath)) {
+        return;
+    }
+    
+    const char* data = mapping.getData();
+    FileOffset length = mapping.getSize();
+    FileOffset pos = FILE_HEADER_SIZE;
+    FrameHeader header;
+    
+    while (readFrameHeader(data, length, pos, header) && pos + (FileOffset)(FRAME_HEADER_SIZE + header.length) <= length) {
+        if (header.type == RECORD_RESTAURANT) {
+            ByteReader reader(data + pos + FRAME_HEADER_SIZE, header.length);
+            int idLength = reader.read<int>();
+            if (reader.ok && idLength > 0 && reader.has(idLength)) {
+                nextId = max(nextId, restaurantIdNumber(data + pos + FRAME_HEADER_SIZE + sizeof(int), idLength) + 1);
+            }
+        } else if (header.type == RECORD_DICTIONARY) {
+            const char* payload = data + pos + FRAME_HEADER_SIZE;
+            ByteReader reader(payload, header.length);
+            StringCode code;
+            string value;
+            if (crc32(payload, header.length) != header.checksum || !decodeDictionaryEntry(reader, code, value) || !dictionary.define(code, value)) {
+                break;
+            }
+        } else if (header.type == RECORD_BLOCK) {
+            BlockHeader blockHeader;
+            if (!readBlockHeader(data + pos + FRAME_HEADER_SIZE, header.length, blockHeader)) {
+                break;
+            }
+            blockIndex.add(pos, blockHeader.records);
+            nextId = max(nextId, blockHeader.maxIdNumber + 1);
+        }
+        pos += FRAME_HEADER_SIZE + header.length;
+    }
+    
+    mapping.close();
+    if (pos < length) {
+        recoverTornTail(pos);
+    }
+}
+
+void DiskDatabase::startIndexBuild() {
+    if (indexState != INDEX_MISSING) {
+        return;
+    }
+    
+    stagedIndexes.reset(new IndexSet());
+    stagedCutoff = getDataFileLength();
+    indexState = INDEX_BUILDING;
+    indexBuildDone = false;
+    
+    string path = dataFilePath;
+    FileOffset cutoff = stagedCutoff;
+    int threads = rebuildThreads;
+    IndexSet* staged = stagedIndexes.get();
+    
+    indexThread = thread([this, path, cutoff, threads, staged]() {
+        buildIndexSet(path, cutoff, threads, *staged);
+        indexBuildDone = true;
+    });
+}
+
+// Restaurants appended from start on, decoded with the dictionary they were written against.
+static vector<Restaurant> readRestaurantsFrom(const string& path, FileOffset start, const StringDictionary& dictionary) {
+    vector<Restaurant> records;
+    RecordScanner scanner(path, start);
+    FileOffset offset;
+    FrameHeader header;
+    const char* payload;
+    
+    while (scanner.next(offset, header, payload)) {
+        Restaurant r;
+        ByteReader reader(payload, header.length);
+        if (header.type == RECORD_RESTAURANT && decodeRestaurant(reader, dictionary, r)) {
+            records.push_back(r);
+        }
+    }
+    return records;
+}
+
+void DiskDatabase::installStagedIndexes() {
+    indexThread.join();
+    
+    IndexSet& staged = *stagedIndexes;
+    ratingIndex.swap(staged.ratingIndex);
+    priceIndex.swap(staged.priceIndex);
+    idIndex.swap(staged.idIndex);
+    cuisineIndex.swap(staged.cuisineIndex);
+    locationIndex.swap(staged.locationIndex);
+    tenantIndex.swap(staged.tenantIndex);
+    columns.swap(staged.columns);
+    deadRecords = 0;
+    nextId = max(nextId, staged.maxId + 1);
+    indexState = INDEX_READY;
+    
+    if (staged.validEnd < stagedCutoff) {
+        // Inserts made while the build ran lie past the cutoff and were already acknowledged, so they are
+        // written again after the truncation. Updates and deletes never run during a build: they wait in ensureIndexes.
+        bufferPool.close();
+        vector<Restaurant> appended = readRestaurantsFrom(dataFilePath, stagedCutoff, dictionary);
+        dictionary.swap(staged.dictionary);
+        recordCache.clear();
+        recoverTornTail(staged.validEnd);
+    
+        vector<FileOffset> offsets = appended.empty() ? vector<FileOffset>() : writeRestaurantsToDisk(appended, true);
+        if (offsets.size() != appended.size()) {
+            cerr << "Error. can not rewrite " << appended.size() << " records added during the index build" << endl;
+        }
+        for (size_t i = 0; i < offsets.size(); i++) {
+            indexRestaurant(appended[i], offsets[i]);
+        }
+        if (!appended.empty()) {
+            cout << "Rewrote " << offsets.size() << " records added during the index build" << endl;
+        }
+    } else {
+        rebuildIndexes(stagedCutoff);
+    }
+    
+    stagedIndexes.reset();
+    saveIndexSnapshot();
+}
+
+// Searches call this and fall back to a scan while the build is still running.
+bool DiskDatabase::useIndexes() {
+    if (indexState == INDEX_MISSING) {
+        startIndexBuild();
+    }
+    if (indexState == INDEX_BUILDING && indexBuildDone) {
+        installStagedIndexes();
+    }
+    return indexState == INDEX_READY;
+}
+
+void DiskDatabase::ensureIndexes() {
+    if (indexState == INDEX_READY) {
+        return;
+    }
+    
+    auto start = chrono::steady_clock::now();
+    startIndexBuild();
+    installStagedIndexes();
+    cout << "Waited " << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms for index build" << endl;
+}
+
+vector<FileOffset> DiskDatabase::scanOffsets(const RestaurantQuery& q) {
+    unordered_map<string, pair<FileOffset, bool>> latest;
+    StringCode cuisineCode = dictionary.lookup(q.cuisine);
+    StringCode locationCode = dictionary.lookup(q.location);
+    
+    RecordScanner scanner(dataFilePath);
+    FileOffset offset;
+    FrameHeader header;
+    const char* payload;
+    
+    while (scanner.next(offset, header, payload)) {
+        ByteReader reader(payload, header.length);
+    
+        if (header.type == RECORD_TOMBSTONE) {
+            latest.erase(reader.readString());
+            continue;
+        }
+    
+        RestaurantView view;
+        if (header.type != RECORD_RESTAURANT || !view.parse(reader, dictionary)) {
+            continue;
+        }
+    
+        bool match = (!q.hasRating || (view.overallRating >= q.minRating && view.overallRating <= q.maxRating)) &&
+                     (!q.hasPrice || (view.averagePrice >= q.minPrice && view.averagePrice <= q.maxPrice)) &&
+                     (q.location.empty() || view.locationCode == locationCode) &&
+                     (q.tenant.empty() || tenantOf(view.restaurantId) == q.tenant) &&
+                     (q.cuisine.empty() || view.hasCuisine(cuisineCode));
+    
+        latest[string(view.restaurantId)] = make_pair(offset, match);
+    }
+    
+    vector<FileOffset> offsets;
+    for (const auto& entry : latest) {
+        if (entry.second.second) {
+            offsets.push_back(entry.second.first);
+        }
+    }
+    sort(offsets.begin(), offsets.end());
+    
+    cout << "Index build in progress, scanned " << latest.size() << " restaurants" << endl;
+    return offsets;
+}
+
+void DiskDatabase::recoverTornTail(FileOffset validEnd) {
+    FileOffset length = getDataFileLength();
+    if (validEnd >= length) {
+        return;
+    }
+    
+    error_code ec;
+    
+    ifstream file(dataFilePath, ios::binary);
+    file.seekg(validEnd);
+    char headerBytes[FRAME_HEADER_SIZE];
+    file.read(headerBytes, sizeof(headerBytes));
+    FrameHeader header;
+    bool torn = !file || !readFrameHeader(headerBytes, sizeof(headerBytes), 0, header) || validEnd + (FileOffset)(FRAME_HEADER_SIZE + header.length) >= length;
+    file.close();
+    
+    if (!torn) {
+        string backupPath = dataFilePath + ".corrupt-" + to_string(validEnd);
+        filesystem::copy_file(dataFilePath, backupPath, filesystem::copy_options::overwrite_existing, ec);
+        cerr << "Warning. corrupt record at offset " << validEnd << ", damaged file saved to " << backupPath << endl;
+    }
+    
+    appendLog.close();
+    mappedData.close();
+    bufferPool.close();
+    blockIndex.truncate(validEnd);
+    blockCache.clear();
+    filesystem::resize_file(dataFilePath, validEnd, ec);
+    if (ec) {
+        cerr << "Error. can not truncate " << dataFilePath << ": " << ec.message() << endl;
+        return;
+    }
+    
+    cout << "Recovered data file: dropped " << (length - validEnd) << " bytes after offset " << validEnd << endl;
+}
+
+FileOffset DiskDatabase::getDataFileLength() {
+    error_code ec;
+    uintmax_t length = filesystem::file_size(dataFilePath, ec);
+    if (ec) {
+        return 0;
+    }
+    return (FileOffset)length;
+}
+
+bool DiskDatabase::loadIndexSnapshot() {
+    ifstream file(indexFilePath, ios::binary);
+    if (!file) {
+        return false;
+    }
+    
+    string snapshot((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    file.close();
+    
+    // Every read is bounds-checked, so a damaged field fails the whole snapshot instead of shifting the ones after it.
+    ByteReader reader(snapshot.data(), snapshot.size());
+    const char* magic = reader.readBytes(4);
+    int version = reader.read<int>();
+    FileOffset coveredLength = reader.read<FileOffset>();
+    uint64_t coveredFileId = reader.read<uint64_t>();
+    int storedNextId = reader.read<int>();
+    
+    if (!reader.ok || memcmp(magic, "FSIX", 4) != 0 || version != INDEX_SNAPSHOT_VERSION) {
+        cout << "Index snapshot unusable, rebuilding" << endl;
+        return false;
+    }
+    
+    // A compaction or restore can leave a different file behind the same path, possibly a longer one.
+    if (coveredFileId != fileId) {
+        cout << "Index snapshot belongs to another data file, rebuilding" << endl;
+        return false;
+    }
+    
+    FileOffset dataLength = getDataFileLength();
+    if (coveredLength > dataLength) {
+        cout << "Index snapshot is newer than data file, rebuilding" << endl;
+        return false;
+    }
+    
+    StringDictionary strings;
+    vector<pair<string, FileOffset>> ids;
+    vector<pair<StringCode, vector<FileOffset>>> cuisines;
+    vector<pair<StringCode, vector<FileOffset>>> locations;
+    vector<pair<float, FileOffset>> ratings;
+    vector<pair<float, FileOffset>> prices;
+    int dead = 0;
+    
+    int count = reader.read<int>();
+    for (int i = 0; i < count && reader.ok; i++) {
+        if (!strings.define(i, reader.readString())) {
+            cout << "Index snapshot dictionary unusable, rebuilding" << endl;
+            return false;
+        }
+    }
+    
+    count = reader.read<int>();
+    for (int i = 0; i < count && reader.ok; i++) {
+        string key = reader.readString();
+        FileOffset offset = reader.read<FileOffset>();
+        ids.push_back(make_pair(key, offset));
+    }
+    
+    vector<pair<StringCode, vector<FileOffset>>>* multiSections[] = {&cuisines, &locations};
+    for (auto section : multiSections) {
+        count = reader.read<int>();
+        for (int i = 0; i < count && reader.ok; i++) {
+            StringCode key = reader.read<StringCode>();
+            int numOffsets = reader.read<int>();
+            const char* bytes = numOffsets < 0 ? nullptr : reader.readBytes(numOffsets * sizeof(FileOffset));
+            if (!bytes) {
+                cout << "Index snapshot truncated, rebuilding" << endl;
+                return false;
+            }
+            vector<FileOffset> offsets(numOffsets);
+            memcpy(offsets.data(), bytes, numOffsets * sizeof(FileOffset));
+            section->push_back(make_pair(key, offsets));
+        }
+    }
+    
+    vector<pair<float, FileOffset>>* treeSections[] = {&ratings, &prices};
+    for (auto section : treeSections) {
+        count = reader.read<int>();
+        for (int i = 0; i < count && reader.ok; i++) {
+            float key = reader.read<float>();
+            FileOffset offset = reader.read<FileOffset>();
+            section->push_back(make_pair(key, offset));
+        }
+    }
+    
+    dead = reader.read<int>();
+    
+    BlockIndex blocks;
+    count = reader.read<int>();
+    for (int i = 0; i < count && reader.ok; i++) {
+        FileOffset offset = reader.read<FileOffset>();
+        uint32_t records = reader.read<uint32_t>();
+        blocks.add(offset, records);
+    }
+    
+    if (!reader.ok) {
+        cout << "Index snapshot truncated, rebuilding" << endl;
+        return false;
+    }
+    
+    dictionary.swap(strings);
+    blockIndex.swap(blocks);
+    unordered_map<string, vector<FileOffset>> tenants;
+    for (const auto& entry : ids) {
+        idIndex.insert(entry.first, entry.second);
+        string_view tenant = tenantOf(entry.first);
+        if (!tenant.empty()) {
+            tenants[string(tenant)].push_back(entry.second);
+        }
+    }
+    for (auto& entry : tenants) {
+        sort(entry.second.begin(), entry.second.end());
+        tenantIndex.insertAll(entry.first, entry.second);
+    }
+    for (const auto& entry : cuisines) {
+        cuisineIndex.insertAll(entry.first, entry.second);
+    }
+    for (const auto& entry : locations) {
+        locationIndex.insertAll(entry.first, entry.second);
+    }
+    loadSortedTree(ratingIndex, ratings);
+    loadSortedTree(priceIndex, prices);
+    deadRecords = dead;
+    
+    nextId = storedNextId;
+    
+    if (!columns.load(columnFilePath, coveredLength)) {
+        rebuildColumns();
+    }
+    
+    if (coveredLength < dataLength) {
+        cout << "Replaying " << (dataLength - coveredLength) << " bytes past index checkpoint" << endl;
+        rebuildIndexes(coveredLength);
+        saveIndexSnapshot();
+    }
+    
+    return true;
+}
+
+bool DiskDatabase::saveIndexSnapshot() {
+    if (indexState != INDEX_READY) {
+        return false;
+    }
+    
+    string tempPath = indexFilePath + ".tmp";
+    ofstream file(tempPath, ios::binary | ios::trunc);
+    if (!file) {
+        cerr << "Error. can not write index snapshot" << endl;
+        return false;
+    }
+    
+    int version = INDEX_SNAPSHOT_VERSION;
+    FileOffset coveredLength = getDataFileLength();
+    
+    file.write("FSIX", 4);
+    file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+    file.write(reinterpret_cast<const char*>(&coveredLength), sizeof(coveredLength));
+    file.write(reinterpret_cast<const char*>(&fileId), sizeof(fileId));
+    file.write(reinterpret_cast<const char*>(&nextId), sizeof(nextId));
+    
+    int count = dictionary.size();
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (int i = 0; i < count; i++) {
+        writeString(file, dictionary.value(i));
+    }
+    
+    vector<pair<string, FileOffset>> ids = idIndex.getAllEntries();
+    count = ids.size();
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (const auto& entry : ids) {
+        writeString(file, entry.first);
+        file.write(reinterpret_cast<const char*>(&entry.second), sizeof(entry.second));
+    }
+    
+    MultiValueHashTable<StringCode, FileOffset>* multiIndexes[] = {&cuisineIndex, &locationIndex};
+    for (auto index : multiIndexes) {
+        vector<StringCode> keys = index->getAllKeys();
+        count = keys.size();
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& key : keys) {
+            vector<FileOffset> offsets = index->get(key);
+            int numOffsets = offsets.size();
+            file.write(reinterpret_cast<const char*>(&key), sizeof(key));
+            file.write(reinterpret_cast<const char*>(&numOffsets), sizeof(numOffsets));
+            file.write(reinterpret_cast<const char*>(offsets.data()), numOffsets * sizeof(FileOffset));
+        }
+    }
+    
+    BPlusTree<float, FileOffset>* treeIndexes[] = {&ratingIndex, &priceIndex};
+    for (auto index : treeIndexes) {
+        vector<pair<float, FileOffset>> pairs = index->getAllPairs();
+        count = pairs.size();
+        file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+        for (const auto& entry : pairs) {
+            file.write(reinterpret_cast<const char*>(&entry.first), sizeof(entry.first));
+            file.write(reinterpret_cast<const char*>(&entry.second), sizeof(entry.second));
+        }
+    }
+    
+    file.write(reinterpret_cast<const char*>(&deadRecords), sizeof(deadRecords));
+    
+    count = blockIndex.size();
+    file.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    for (int i = 0; i < count; i++) {
+        FileOffset offset = blockIndex.blockStart(i);
+        uint32_t records = blockIndex.blockRecords(i);
+        file.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        file.write(reinterpret_cast<const char*>(&records), sizeof(records));
+    }
+    
+    file.close();
+    if (!file) {
+        cerr << "Error. failed writing index snapshot" << endl;
+        return false;
+    }
+    
+    error_code ec;
+    filesystem::rename(tempPath, indexFilePath, ec);
+    if (ec) {
+        cerr << "Error. can not replace index snapshot: " << ec.message() << endl;
+        return false;
+    }
+    
+    string columnTempPath = columnFilePath + ".tmp";
+    if (columns.save(columnTempPath, coveredLength)) {
+        filesystem::rename(columnTempPath, columnFilePath, ec);
+    }
+    
+    writesSinceCheckpoint = 0;
+    return true;
+}
+
+void DiskDatabase::checkpointIndexes() {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    saveIndexSnapshot();
+}
+
+StorageMode DiskDatabase::getStorageMode() const {
+    return storageMode;
+}
+
+void DiskDatabase::setDurability(DurabilityLevel level) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    durability = level;
+}
+
+void DiskDatabase::setRebuildThreads(int threads) {
+    if (threads <= 0) {
+        threads = thread::hardware_concurrency();
+    }
+    rebuildThreads = max(1, threads);
+}
+
+int DiskDatabase::getRebuildThreads() const {
+    return rebuildThreads;
+}
+
+DurabilityLevel DiskDatabase::getDurability() const {
+    return durability;
+}
+
+void DiskDatabase::setCompression(CompressionMode mode) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    compression = mode;
+}
+
+CompressionMode DiskDatabase::getCompression() const {
+    return compression;
+}
+
+string DiskDatabase::addRestaurant(const string& name, const string& location,const vector<string>& cuisineTypes, float rating,float avgPrice, const vector<Dish>& dishes,const string& notes, const string& tenant) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    
+    string id = tenantKey(tenant, generateId());
+    
+    Restaurant restaurant;
+    restaurant.restaurantId = id;
+    restaurant.name = name;
+    restaurant.location = location;
+    restaurant.cuisineTypes = cuisineTypes;
+    restaurant.overallRating = rating;
+    restaurant.averagePrice = avgPrice;
+    restaurant.dishes = dishes;
+    restaurant.lastVisitDate = time(nullptr);
+    restaurant.totalVisits = 1;
+    restaurant.notes = notes;
+    
+    if (!dishes.empty()) {
+        restaurant.updateAveragePrice();
+    }
+    
+    FileOffset offset = writeRestaurantToDisk(restaurant);
     
-    if (len <= 0 || len > 10000) {
+    if (offset < 0) {
+        cerr << "Failed to write to disk" << endl;
         return "";
     }
     
-    char* buffer = new char[len + 1];
-    file.read(buffer, len);
-    buffer[len] = '\0';
+    if (indexState == INDEX_READY) {
+        indexRestaurant(restaurant, offset);
+    }
+    noteWrites(1);
+    
+    cout << "Restaurant added: " << id << endl;
+    
+    return id;
+}
+
+vector<string> DiskDatabase::addRestaurants(const vector<Restaurant>& batch, bool sync, const string& tenant) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    
+    vector<Restaurant> records;
+    records.reserve(batch.size());
+    
+    for (const auto& input : batch) {
+        Restaurant restaurant = input;
+        restaurant.restaurantId = tenantKey(tenant, generateId());
+        if (restaurant.lastVisitDate == 0) {
+            restaurant.lastVisitDate = time(nullptr);
+        }
+        if (restaurant.totalVisits < 1) {
+            restaurant.totalVisits = 1;
+        }
+        if (!restaurant.dishes.empty()) {
+            restaurant.updateAveragePrice();
+        }
+        records.push_back(restaurant);
+    }
+    
+    vector<string> ids;
+    if (records.empty()) {
+        return ids;
+    }
+    
+    vector<FileOffset> offsets = writeRestaurantsToDisk(records, sync);
+    if (offsets.empty()) {
+        cerr << "Failed to write batch to disk" << endl;
+        return ids;
+    }
+    
+    for (size_t i = 0; i < records.size(); i++) {
+        if (indexState == INDEX_READY) {
+            indexRestaurant(records[i], offsets[i]);
+        }
+        ids.push_back(records[i].restaurantId);
+    }
+    
+    noteWrites(records.size());
+    
+    cout << "Batch added: " << ids.size() << " restaurants" << endl;
+    
+    return ids;
+}
+
+// Copies records from another database under the tenant, keeping their ids so a repeated
+// import supersedes the earlier copy instead of duplicating it.
+int DiskDatabase::importRestaurants(const vector<Restaurant>& batch, const string& tenant) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    
+    vector<Restaurant> records;
+    records.reserve(batch.size());
+    for (const auto& input : batch) {
+        if (input.restaurantId.empty()) {
+            continue;
+        }
+        Restaurant restaurant = input;
+        restaurant.restaurantId = tenantKey(tenant, string(localId(input.restaurantId)));
+        records.push_back(restaurant);
+    }
+    
+    if (records.empty()) {
+        return 0;
+    }
+    
+    vector<FileOffset> offsets = writeRestaurantsToDisk(records, true);
+    if (offsets.empty()) {
+        cerr << "Failed to write import to disk" << endl;
+        return 0;
+    }
+    
+    for (size_t i = 0; i < records.size(); i++) {
+        if (indexState == INDEX_READY) {
+            indexRestaurant(records[i], offsets[i]);
+        }
+    }
+    
+    noteWrites(records.size());
+    return records.size();
+}
+
+void DiskDatabase::noteWrites(int count) {
+    writesSinceCheckpoint += count;
+    if (writesSinceCheckpoint >= INDEX_CHECKPOINT_INTERVAL) {
+        saveIndexSnapshot();
+    }
+}
+
+bool DiskDatabase::updateRestaurant(const Restaurant& r) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
+    
+    if (!idIndex.contains(r.restaurantId)) {
+        return false;
+    }
+    
+    FileOffset offset = writeRestaurantToDisk(r);
+    if (offset < 0) {
+        cerr << "Failed to write update to disk" << endl;
+        return false;
+    }
+    
+    indexRestaurant(r, offset);
+    noteWrites(1);
+    
+    cout << "Restaurant updated: " << r.restaurantId << endl;
+    return true;
+}
+
+bool DiskDatabase::updateRating(const string& id, float rating) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    
+    Restaurant r = getRestaurant(id);
+    if (r.restaurantId.empty()) {
+        return false;
+    }
+    
+    r.overallRating = rating;
+    return updateRestaurant(r);
+}
+
+bool DiskDatabase::recordVisit(const string& id) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    
+    Restaurant r = getRestaurant(id);
+    if (r.restaurantId.empty()) {
+        return false;
+    }
+    
+    r.totalVisits++;
+    r.lastVisitDate = time(nullptr);
+    return updateRestaurant(r);
+}
+
+bool DiskDatabase::deleteRestaurant(const string& id) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
+    
+    if (!idIndex.contains(id)) {
+        return false;
+    }
+    
+    string payload;
+    ByteWriter writer(payload);
+    writer.writeString(id);
+    
+    if (appendRecords(RECORD_TOMBSTONE, vector<string>{payload}, false).empty()) {
+        cerr << "Failed to write tombstone to disk" << endl;
+        return false;
+    }
+    
+    applyTombstone(id);
+    noteWrites(1);
+    
+    cout << "Restaurant deleted: " << id << endl;
+    return true;
+}
+
+void DiskDatabase::runCompaction() {
+    auto start = chrono::steady_clock::now();
+    
+    CompactionStats stats;
+    FileOffset cutoff;
+    HashTable<FileOffset, bool> live(1000);
+    bool compress;
+    
+    {
+        lock_guard<recursive_mutex> lock(dbMutex);
+        ensureIndexes();
+        cutoff = getDataFileLength();
+        compress = compression == COMPRESSION_BLOCKS;
+        for (const auto& entry : idIndex.getAllEntries()) {
+            live.insert(entry.second, true);
+        }
+    }
+    
+    string tempPath = dataFilePath + ".compact";
+    ofstream out(tempPath, ios::binary | ios::trunc);
+    if (!out) {
+        cerr << "Error. can not create " << tempPath << endl;
+        return;
+    }
+    
+    string header;
+    uint64_t compactedId = appendDataFileStart(header);
+    out.write(header.data(), header.size());
+    
+    HashTable<FileOffset, FileOffset> moved(1000);
+    FileOffset writePos = header.size();
+    
+    // When compressing, live records wait in pending and get their new offsets once their block is written.
+    BlockIndex blocks;
+    string pending;
+    vector<FileOffset> pendingOffsets;
+    int pendingMaxId = 0;
+    auto writeBlock = [&]() {
+        if (pendingOffsets.empty()) {
+            return;
+        }
+        string payload;
+        string frameBytes;
+        encodeBlock(pending, pendingOffsets.size(), pendingMaxId, payload);
+        appendFrame(frameBytes, RECORD_BLOCK, payload);
+        out.write(frameBytes.data(), frameBytes.size());
+    
+        blocks.add(writePos, pendingOffsets.size());
+        for (size_t slot = 0; slot < pendingOffsets.size(); slot++) {
+            moved.insert(pendingOffsets[slot], writePos + slot);
+        }
+        writePos += frameBytes.size();
+        pending.clear();
+        pendingOffsets.clear();
+        pendingMaxId = 0;
+    };
+    
+    RecordScanner scanner(dataFilePath);
+    FileOffset offset;
+    FrameHeader frame;
+    const char* payload;
+    
+    while (scanner.next(offset, frame, payload) && offset < cutoff) {
+        FileOffset frameSize = FRAME_HEADER_SIZE + frame.length;
+    
+        if (frame.type == RECORD_FILE_ID) {
+            continue;
+        }
+    
+        // Dictionary frames are always kept: codes are never reassigned, so live records may still use them.
+        if (frame.type != RECORD_DICTIONARY && !live.contains(offset)) {
+            stats.droppedRecords++;
+            continue;
+        }
+    
+        if (compress && frame.type == RECORD_RESTAURANT) {
+            ByteReader reader(payload, frame.length);
+            string id = reader.readString();
+            pendingMaxId = max(pendingMaxId, restaurantIdNumber(id.data(), id.size()));
+            pending.append(payload - FRAME_HEADER_SIZE, frameSize);
+            pendingOffsets.push_back(offset);
+            stats.liveRecords++;
+            if (pending.size() >= COMPRESSED_BLOCK_BYTES) {
+                writeBlock();
+            }
+            continue;
+        }
+    
+        out.write(payload - FRAME_HEADER_SIZE, frameSize);
+        writePos += frameSize;
+        if (frame.type == RECORD_RESTAURANT) {
+            moved.insert(offset, writePos - frameSize);
+            stats.liveRecords++;
+        }
+    }
+    writeBlock();
+    
+    error_code ec;
+    
+    if (scanner.isCorrupt() && scanner.position() < cutoff) {
+        cerr << "Error. corrupt record at offset " << scanner.position() << ", compaction aborted" << endl;
+        out.close();
+        filesystem::remove(tempPath, ec);
+        return;
+    }
+    
+    lock_guard<recursive_mutex> lock(dbMutex);
+    
+    FileOffset end = getDataFileLength();
+    stats.bytesBefore = end;
+    if (end > cutoff) {
+        ifstream tail(dataFilePath, ios::binary);
+        tail.seekg(cutoff);
+        string tailBytes(end - cutoff, '\0');
+        tail.read(&tailBytes[0], tailBytes.size());
+        out.write(tailBytes.data(), tailBytes.size());
+    }
+    
+    out.close();
+    if (!out) {
+        cerr << "Error. failed writing " << tempPath << endl;
+        filesystem::remove(tempPath, ec);
+        return;
+    }
+    
+    appendLog.close();
+    mappedData.close();
+    bufferPool.close();
+    recordCache.clear();
+    
+    filesystem::rename(tempPath, dataFilePath, ec);
+    if (ec) {
+        cerr << "Error. can not swap compacted file: " << ec.message() << endl;
+        return;
+    }
+    fileId = compactedId;
+    blockIndex.swap(blocks);
+    blockCache.clear();
+    
+    vector<pair<string, FileOffset>> ids = idIndex.getAllEntries();
+    vector<pair<StringCode, vector<FileOffset>>> cuisines;
+    vector<pair<StringCode, vector<FileOffset>>> locations;
+    for (const auto& key : cuisineIndex.getAllKeys()) {
+        cuisines.push_back(make_pair(key, cuisineIndex.get(key)));
+    }
+    for (const auto& key : locationIndex.getAllKeys()) {
+        locations.push_back(make_pair(key, locationIndex.get(key)));
+    }
+    vector<pair<float, FileOffset>> ratings = ratingIndex.getAllPairs();
+    vector<pair<float, FileOffset>> prices = priceIndex.getAllPairs();
     
-    string result(buffer);
-    delete[] buffer;
+    auto movedLive = [&](FileOffset oldOffset, FileOffset& newOffset) {
+        FileOffset* target = moved.get(oldOffset);
+        if (!target) {
+            return false;
+        }
+        newOffset = *target;
+        return true;
+    };
+    
+    clearIndexes();
+    
+    // Each list is remapped on its own and loaded with one insertAll, rather than deduplicating per offset.
+    FileOffset newOffset;
+    unordered_map<string, vector<FileOffset>> tenants;
+    for (const auto& entry : ids) {
+        if (movedLive(entry.second, newOffset)) {
+            idIndex.insert(entry.first, newOffset);
+            string_view tenant = tenantOf(entry.first);
+            if (!tenant.empty()) {
+                tenants[string(tenant)].push_back(newOffset);
+            }
+        }
+    }
+    for (auto& entry : tenants) {
+        sort(entry.second.begin(), entry.second.end());
+        tenantIndex.insertAll(entry.first, entry.second);
+    }
     
-    return result;
+    auto remapMoved = [&](const vector<pair<StringCode, vector<FileOffset>>>& lists, MultiValueHashTable<StringCode, FileOffset>& index) {
+        for (const auto& entry : lists) {
+            vector<FileOffset> offsets;
+            offsets.reserve(entry.second.size());
+            for (const auto& oldOffset : entry.second) {
+                if (movedLive(oldOffset, newOffset)) {
+                    offsets.push_back(newOffset);
+                }
+            }
+            if (!offsets.empty()) {
+                index.insertAll(entry.first, offsets);
+            }
+        }
+    };
+    remapMoved(cuisines, cuisineIndex);
+    remapMoved(locations, locationIndex);
+    
+    // Records keep their order in the new file, so the remapped entries stay sorted.
+    auto loadMoved = [&](vector<pair<float, FileOffset>>& entries, BPlusTree<float, FileOffset>& tree) {
+        size_t kept = 0;
+        for (const auto& entry : entries) {
+            if (movedLive(entry.second, newOffset)) {
+                entries[kept++] = make_pair(entry.first, newOffset);
+            }
+        }
+        entries.resize(kept);
+        loadSortedTree(tree, entries);
+    };
+    loadMoved(ratings, ratingIndex);
+    loadMoved(prices, priceIndex);
+    
+    rebuildColumns();
+    rebuildIndexes(writePos);
+    saveIndexSnapshot();
+    
+    stats.bytesAfter = getDataFileLength();
+    stats.elapsedMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    lastCompaction = stats;
+    
+    cout << "Compaction done: kept " << stats.liveRecords << " records, dropped " << stats.droppedRecords
+         << ", reclaimed " << stats.reclaimedBytes() << " bytes in " << stats.elapsedMs << " ms" << endl;
 }
 
-void DiskDatabase::writeStringVector(ofstream& file, const vector<string>& vec) {
-    int size = vec.size();
-    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
-    
-    for (const auto& str : vec) 
-    {
-        writeString(file, str);
+CompactionStats DiskDatabase::compact() {
+    bool expected = false;
+    if (!compacting.compare_exchange_strong(expected, true)) {
+        return getLastCompactionStats();
     }
+    
+    runCompaction();
+    compacting = false;
+    
+    return getLastCompactionStats();
 }
 
-vector<string> DiskDatabase::readStringVector(ifstream& file) {
-    int size;
-    file.read(reinterpret_cast<char*>(&size), sizeof(size));
+bool DiskDatabase::startCompaction() {
+    bool expected = false;
+    if (!compacting.compare_exchange_strong(expected, true)) {
+        return false;
+    }
     
-    vector<string> result;
-    for (int i = 0; i < size; i++) {
-        result.push_back(readString(file));
+    if (compactionThread.joinable()) {
+        compactionThread.join();
     }
     
-    return result;
+    compactionThread = thread([this]() {
+        runCompaction();
+        compacting = false;
+    });
+    
+    return true;
 }
 
-void DiskDatabase::writeDish(ofstream& file, const Dish& dish) {
-    writeString(file, dish.dishName);
-    file.write(reinterpret_cast<const char*>(&dish.rating), sizeof(dish.rating));
-    file.write(reinterpret_cast<const char*>(&dish.price), sizeof(dish.price));
+bool DiskDatabase::isCompacting() const {
+    return compacting;
 }
 
-Dish DiskDatabase::readDish(ifstream& file) {
-    Dish dish;
-    dish.dishName = readString(file);
-    file.read(reinterpret_cast<char*>(&dish.rating), sizeof(dish.rating));
-    file.read(reinterpret_cast<char*>(&dish.price), sizeof(dish.price));
-    return dish;
+CompactionStats DiskDatabase::getLastCompactionStats() const {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return lastCompaction;
 }
 
-void DiskDatabase::writeDishVector(ofstream& file, const vector<Dish>& dishes) {
-    int size = dishes.size();
-    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
-    
-    for (const auto& dish : dishes) {
-        writeDish(file, dish);
-    }
+CacheStats DiskDatabase::getCacheStats() const {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return recordCache.getStats();
 }
 
-vector<Dish> DiskDatabase::readDishVector(ifstream& file) {
-    int size;
-    file.read(reinterpret_cast<char*>(&size), sizeof(size));
-    
-    vector<Dish> result;
-    for (int i = 0; i < size; i++) {
-        result.push_back(readDish(file));
+void DiskDatabase::setCacheCapacity(size_t bytes) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    recordCache.setCapacity(bytes);
+}
+
+// One budget for everything cached from the data file. Paged mode gives most of it to raw pages and the
+// rest to decoded records; the other modes only have the record cache.
+void DiskDatabase::setMemoryBudget(size_t bytes) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    if (storageMode != STORAGE_PAGED) {
+        recordCache.setCapacity(bytes);
+        return;
     }
     
-    return result;
+    size_t poolBytes = bytes / 4 * 3;
+    bufferPool.setCapacity(poolBytes);
+    recordCache.setCapacity(bytes - poolBytes);
 }
 
+BufferPoolStats DiskDatabase::getBufferPoolStats() const {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return bufferPool.getStats();
+}
 
-DiskDatabase::DiskDatabase(const string& filepath) : dataFilePath(filepath), ratingIndex(3), priceIndex(3),idIndex(1000), cuisineIndex(500), locationIndex(200), nextId(1) 
-{
-    cout << "Data file: " << dataFilePath << endl;
-    
-    ifstream testFile(dataFilePath, ios::binary);
-    if (testFile.good()) 
-    {
-        testFile.close();
-        cout << "data file found" << endl;
-        rebuildIndexes();
-        cout << "Indexes built" << endl;
-    } 
-    else 
-    {
-        cout << "No existing file." << endl;
+TreeMemoryStats DiskDatabase::getIndexMemoryStats(SortField field) const {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return field == SORT_BY_PRICE ? priceIndex.getMemoryStats() : ratingIndex.getMemoryStats();
+}
+
+int DiskDatabase::getDeadRecordCount() const {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return deadRecords;
+}
+
+vector<FileOffset> DiskDatabase::ratingOffsets(float minRating, float maxRating) {
+    if (!useIndexes()) {
+        RestaurantQuery q;
+        q.setRating(minRating, maxRating);
+        return scanOffsets(q);
     }
+    return ratingIndex.searchRange(minRating, maxRating);
+}
 
+vector<FileOffset> DiskDatabase::priceOffsets(float minPrice, float maxPrice) {
+    if (!useIndexes()) {
+        RestaurantQuery q;
+        q.setPrice(minPrice, maxPrice);
+        return scanOffsets(q);
+    }
+    return priceIndex.searchRange(minPrice, maxPrice);
 }
 
-DiskDatabase::~DiskDatabase() 
-{
-    //cout << "Database closed" << endl;
+vector<FileOffset> DiskDatabase::cuisineOffsets(const string& cuisine) {
+    if (!useIndexes()) {
+        RestaurantQuery q;
+        q.cuisine = cuisine;
+        return scanOffsets(q);
+    }
+    return cuisineIndex.get(dictionary.lookup(cuisine));
 }
 
-string DiskDatabase::generateId() 
-{
-    return "rest_" + to_string(nextId++);
+vector<FileOffset> DiskDatabase::locationOffsets(const string& location) {
+    if (!useIndexes()) {
+        RestaurantQuery q;
+        q.location = location;
+        return scanOffsets(q);
+    }
+    return locationIndex.get(dictionary.lookup(location));
 }
 
-FileOffset DiskDatabase::writeRestaurantToDisk(const Restaurant& r) {
-    ofstream file(dataFilePath, ios::binary | ios::app);
-    if (!file) {
-        cerr << "Error. can not open file" << endl;
-        return -1;
+vector<FileOffset> DiskDatabase::rangeOffsets(float minRating, float maxRating, float minPrice, float maxPrice) {
+    if (!useIndexes()) {
+        RestaurantQuery q;
+        q.setRating(minRating, maxRating);
+        q.setPrice(minPrice, maxPrice);
+        return scanOffsets(q);
     }
+    return columns.filter(minRating, maxRating, minPrice, maxPrice);
+}
+
+vector<Restaurant> DiskDatabase::searchByRatingRange(float minRating, float maxRating) 
+{
+    lock_guard<recursive_mutex> lock(dbMutex);
     
-    FileOffset offset = file.tellp();
-    
-    writeString(file, r.restaurantId);
-    writeString(file, r.name);
-    writeString(file, r.location);
-    writeStringVector(file, r.cuisineTypes);
-    
-    file.write(reinterpret_cast<const char*>(&r.overallRating), sizeof(r.overallRating));
-    file.write(reinterpret_cast<const char*>(&r.averagePrice), sizeof(r.averagePrice));
-    
-    writeDishVector(file, r.dishes);
+    vector<FileOffset> offsets = ratingOffsets(minRating, maxRating);
     
-    file.write(reinterpret_cast<const char*>(&r.lastVisitDate), sizeof(r.lastVisitDate));
-    file.write(reinterpret_cast<const char*>(&r.totalVisits), sizeof(r.totalVisits));
+    cout << "Found " << offsets.size() << " matches in index" << endl;
+    cout << "Reading from disk." << endl;
     
-    writeString(file, r.notes);
+    return fetchRestaurants(offsets);
+}
+
+vector<Restaurant> DiskDatabase::searchByPriceRange(float minPrice, float maxPrice) 
+{
+    lock_guard<recursive_mutex> lock(dbMutex);
     
-    file.close();
+    vector<FileOffset> offsets = priceOffsets(minPrice, maxPrice);
     
-    //cout << "Written to disk at offset: " << offset << endl;
+    cout << "Found " << offsets.size() << " matches in index" << endl;
+    cout << "Reading from disk." << endl;
     
-    return offset;
+    return fetchRestaurants(offsets);
 }
 
-Restaurant DiskDatabase::readRestaurantFromDisk(FileOffset offset) {
-    Restaurant r;
+vector<Restaurant> DiskDatabase::searchByCuisine(const string& cuisine) {
+    lock_guard<recursive_mutex> lock(dbMutex);
     
-    ifstream file(dataFilePath, ios::binary);
-    if (!file) {
-        cerr << "Error. cannot open file" << endl;
-        return r;
-    }
+    vector<FileOffset> offsets = cuisineOffsets(cuisine);
     
-    file.seekg(offset);
+    cout << "Found " << offsets.size() << " matches in index" << endl;
+    cout << "Reading from disk." << endl;
     
-    r.restaurantId = readString(file);
-    r.name = readString(file);
-    r.location = readString(file);
-    r.cuisineTypes = readStringVector(file);
+    return fetchRestaurants(offsets);
+}
+
+vector<Restaurant> DiskDatabase::searchByLocation(const string& location) {
+    lock_guard<recursive_mutex> lock(dbMutex);
     
-    file.read(reinterpret_cast<char*>(&r.overallRating), sizeof(r.overallRating));
-    file.read(reinterpret_cast<char*>(&r.averagePrice), sizeof(r.averagePrice));
+    vector<FileOffset> offsets = locationOffsets(location);
     
-    r.dishes = readDishVector(file);
+    cout << "Found " << offsets.size() << " matches in index" << endl;
+    cout << "Reading from disk." << endl;
     
-    file.read(reinterpret_cast<char*>(&r.lastVisitDate), sizeof(r.lastVisitDate));
-    file.read(reinterpret_cast<char*>(&r.totalVisits), sizeof(r.totalVisits));
+    return fetchRestaurants(offsets);
+}
+
+vector<RestaurantView> DiskDatabase::searchViewsByRatingRange(float minRating, float maxRating) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return readViews(ratingOffsets(minRating, maxRating));
+}
+
+vector<RestaurantView> DiskDatabase::searchViewsByPriceRange(float minPrice, float maxPrice) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return readViews(priceOffsets(minPrice, maxPrice));
+}
+
+vector<RestaurantView> DiskDatabase::searchViewsByCuisine(const string& cuisine) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return readViews(cuisineOffsets(cuisine));
+}
+
+vector<RestaurantView> DiskDatabase::searchViewsByLocation(const string& location) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return readViews(locationOffsets(location));
+}
+
+vector<Restaurant> DiskDatabase::searchByRatingAndPrice(float minRating, float maxRating, float minPrice, float maxPrice) {
+    lock_guard<recursive_mutex> lock(dbMutex);
     
-    r.notes = readString(file);
+    vector<FileOffset> offsets = rangeOffsets(minRating, maxRating, minPrice, maxPrice);
     
-    file.close();
+    cout << "Found " << offsets.size() << " matches in columns" << endl;
+    cout << "Reading from disk." << endl;
     
-    return r;
+    return fetchRestaurants(offsets);
 }
 
-void DiskDatabase::rebuildIndexes() {
-    ifstream file(dataFilePath, ios::binary);
-    if (!file) {
-        return;
-    }
-    
-    int count = 0;
-    
-    while (file.good() && file.peek() != EOF) {
-        FileOffset offset = file.tellg();
-        
-        Restaurant r;
-        r.restaurantId = readString(file);
-        if (r.restaurantId.empty()) break;
-        
-        r.name = readString(file);
-        r.location = readString(file);
-        r.cuisineTypes = readStringVector(file);
-        
-        file.read(reinterpret_cast<char*>(&r.overallRating), sizeof(r.overallRating));
-        file.read(reinterpret_cast<char*>(&r.averagePrice), sizeof(r.averagePrice));
-        
-        r.dishes = readDishVector(file);
-        
-        file.read(reinterpret_cast<char*>(&r.lastVisitDate), sizeof(r.lastVisitDate));
-        file.read(reinterpret_cast<char*>(&r.totalVisits), sizeof(r.totalVisits));
-        
-        r.notes = readString(file);
-        
-        ratingIndex.insert(r.overallRating, offset);
-        priceIndex.insert(r.averagePrice, offset);
-        idIndex.insert(r.restaurantId, offset);
-        
-        for (const auto& cuisine : r.cuisineTypes) {
-            cuisineIndex.insert(cuisine, offset);
-        }
-        
-        locationIndex.insert(r.location, offset);
-        
-        string idNum = r.restaurantId.substr(5);
-        int num = stoi(idNum);
-        if (num >= nextId) {
-            nextId = num + 1;
-        }
-        
-        count++;
+vector<RestaurantView> DiskDatabase::searchViewsByRatingAndPrice(float minRating, float maxRating, float minPrice, float maxPrice) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return readViews(rangeOffsets(minRating, maxRating, minPrice, maxPrice));
+}
+
+int DiskDatabase::countByRatingAndPrice(float minRating, float maxRating, float minPrice, float maxPrice) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    if (!useIndexes()) {
+        return rangeOffsets(minRating, maxRating, minPrice, maxPrice).size();
     }
-    
-    file.close();
-    
-    //cout << "Indexing done" << endl;
+    return columns.count(minRating, maxRating, minPrice, maxPrice);
 }
 
-string DiskDatabase::addRestaurant(const string& name, const string& location,const vector<string>& cuisineTypes, float rating,float avgPrice, const vector<Dish>& dishes,const string& notes) {
-    string id = generateId();
+vector<FileOffset> DiskDatabase::queryOffsets(const RestaurantQuery& q) {
+    if (!useIndexes()) {
+        return scanOffsets(q);
+    }
     
-    Restaurant restaurant;
-    restaurant.restaurantId = id;
-    restaurant.name = name;
-    restaurant.location = location;
-    restaurant.cuisineTypes = cuisineTypes;
-    restaurant.overallRating = rating;
-    restaurant.averagePrice = avgPrice;
-    restaurant.dishes = dishes;
-    restaurant.lastVisitDate = time(nullptr);
-    restaurant.totalVisits = 1;
-    restaurant.notes = notes;
+    float minRating = q.hasRating ? q.minRating : -numeric_limits<float>::infinity();
+    float maxRating = q.hasRating ? q.maxRating : numeric_limits<float>::infinity();
+    float minPrice = q.hasPrice ? q.minPrice : -numeric_limits<float>::infinity();
+    float maxPrice = q.hasPrice ? q.maxPrice : numeric_limits<float>::infinity();
+    bool hasRange = q.hasRating || q.hasPrice;
     
-    if (!dishes.empty()) {
-        restaurant.updateAveragePrice();
+    vector<vector<FileOffset>> lists;
+    if (!q.tenant.empty()) {
+        lists.push_back(tenantIndex.get(q.tenant));
+    }
+    if (!q.cuisine.empty()) {
+        lists.push_back(cuisineIndex.get(dictionary.lookup(q.cuisine)));
+    }
+    if (!q.location.empty()) {
+        lists.push_back(locationIndex.get(dictionary.lookup(q.location)));
     }
     
-    FileOffset offset = writeRestaurantToDisk(restaurant);
-    
-    if (offset < 0) {
-        cerr << "Failed to write to disk" << endl;
-        return "";
+    sort(lists.begin(), lists.end(), [](const vector<FileOffset>& a, const vector<FileOffset>& b) {
+        return a.size() < b.size();
+    });
+    
+    // The range columns drive the query only when they are more selective than every offset list.
+    size_t rangeCount = hasRange ? columns.count(minRating, maxRating, minPrice, maxPrice) : columns.getLiveRows();
+    bool rangeDrives = lists.empty() || (hasRange && rangeCount < lists[0].size());
+    
+    vector<FileOffset> result;
+    size_t next = 0;
+    if (rangeDrives) {
+        result = columns.filter(minRating, maxRating, minPrice, maxPrice);
+        hasRange = false;
+    } else {
+        result = lists[0];
+        next = 1;
     }
+    sort(result.begin(), result.end());
     
-    ratingIndex.insert(rating, offset);
-    priceIndex.insert(avgPrice, offset);
-    idIndex.insert(id, offset);
+    for (; next < lists.size() && !result.empty(); next++) {
+        vector<FileOffset>& other = lists[next];
+        sort(other.begin(), other.end());
     
-    for (const auto& cuisine : cuisineTypes) {
-        cuisineIndex.insert(cuisine, offset);
+        vector<FileOffset> merged;
+        set_intersection(result.begin(), result.end(), other.begin(), other.end(), back_inserter(merged));
+        result.swap(merged);
     }
     
-    locationIndex.insert(location, offset);
-    
-    cout << "Restaurant added: " << id << endl;
+    if (hasRange) {
+        vector<FileOffset> filtered;
+        for (const auto& offset : result) {
+            if (columns.matches(offset, minRating, maxRating, minPrice, maxPrice)) {
+                filtered.push_back(offset);
+            }
+        }
+        result.swap(filtered);
+    }
     
-    return id;
+    return result;
 }
 
-vector<Restaurant> DiskDatabase::searchByRatingRange(float minRating, float maxRating) 
-{
-    vector<FileOffset> offsets = ratingIndex.searchRange(minRating, maxRating);
+vector<Restaurant> DiskDatabase::query(const RestaurantQuery& q) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    
+    vector<FileOffset> offsets = queryOffsets(q);
     
     cout << "Found " << offsets.size() << " matches in index" << endl;
     cout << "Reading from disk." << endl;
     
-    vector<Restaurant> results;
-    for (const auto& offset : offsets) 
-    {
-        results.push_back(readRestaurantFromDisk(offset));
-    }
-    
-    return results;
+    return fetchRestaurants(offsets);
 }
 
-vector<Restaurant> DiskDatabase::searchByPriceRange(float minPrice, float maxPrice) 
-{
-    vector<FileOffset> offsets = priceIndex.searchRange(minPrice, maxPrice);
+vector<RestaurantView> DiskDatabase::queryViews(const RestaurantQuery& q) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return readViews(queryOffsets(q));
+}
+
+vector<FileOffset> DiskDatabase::topKOffsets(SortField field, int k, const RestaurantQuery& filter, bool descending) {
+    vector<FileOffset> result;
+    if (k <= 0) {
+        return result;
+    }
     
-    cout << "Found " << offsets.size() << " matches in index" << endl;
-    cout << "Reading from disk." << endl;
+    float minRating = filter.hasRating ? filter.minRating : -numeric_limits<float>::infinity();
+    float maxRating = filter.hasRating ? filter.maxRating : numeric_limits<float>::infinity();
+    float minPrice = filter.hasPrice ? filter.minPrice : -numeric_limits<float>::infinity();
+    float maxPrice = filter.hasPrice ? filter.maxPrice : numeric_limits<float>::infinity();
+    bool hasRange = filter.hasRating || filter.hasPrice;
+    
+    // Cuisine/location membership is resolved from the indexes up front so the walk never reads a rejected record.
+    bool hasMembers = !filter.tenant.empty() || !filter.cuisine.empty() || !filter.location.empty();
+    HashTable<FileOffset, bool> members(100);
+    if (hasMembers) {
+        RestaurantQuery keys;
+        keys.tenant = filter.tenant;
+        keys.cuisine = filter.cuisine;
+        keys.location = filter.location;
+        for (const auto& offset : queryOffsets(keys)) {
+            members.insert(offset, true);
+        }
+        if (members.getSize() == 0) {
+            return result;
+        }
+    }
     
-    vector<Restaurant> results;
-    for (const auto& offset : offsets) {
-        results.push_back(readRestaurantFromDisk(offset));
+    auto visit = [&](float, FileOffset offset) {
+        if (hasMembers && !members.contains(offset)) {
+            return true;
+        }
+        if (hasRange && !columns.matches(offset, minRating, maxRating, minPrice, maxPrice)) {
+            return true;
+        }
+        result.push_back(offset);
+        return (int)result.size() < k;
+    };
+    
+    BPlusTree<float, FileOffset>& index = field == SORT_BY_PRICE ? priceIndex : ratingIndex;
+    if (descending) {
+        index.forEachDescending(visit);
+    } else {
+        index.forEachAscending(visit);
     }
     
-    return results;
+    return result;
 }
 
-vector<Restaurant> DiskDatabase::searchByCuisine(const string& cuisine) {
-    vector<FileOffset> offsets = cuisineIndex.get(cuisine);
-    
-    cout << "Found " << offsets.size() << " matches in index" << endl;
-    cout << "Reading from disk." << endl;
+vector<Restaurant> DiskDatabase::topK(SortField field, int k, const RestaurantQuery& filter, bool descending) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
     
-    vector<Restaurant> results;
-    for (const auto& offset : offsets) {
-        results.push_back(readRestaurantFromDisk(offset));
-    }
-    
-    return results;
+    return fetchRestaurants(topKOffsets(field, k, filter, descending));
 }
 
-vector<Restaurant> DiskDatabase::searchByLocation(const string& location) {
-    vector<FileOffset> offsets = locationIndex.get(location);
+vector<RestaurantView> DiskDatabase::topKViews(SortField field, int k, const RestaurantQuery& filter, bool descending) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
+    return readViews(topKOffsets(field, k, filter, descending));
+}
+
+KeyStats<float> DiskDatabase::getFieldStats(SortField field) {
+    return getFieldStats(field, -numeric_limits<float>::infinity(), numeric_limits<float>::infinity());
+}
+
+KeyStats<float> DiskDatabase::getFieldStats(SortField field, float minKey, float maxKey) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
     
-    cout << "Found " << offsets.size() << " matches in index" << endl;
-    cout << "Reading from disk." << endl;
+    BPlusTree<float, FileOffset>& index = field == SORT_BY_PRICE ? priceIndex : ratingIndex;
+    return index.rangeStats(minKey, maxKey);
+}
+
+// With within set, only those offsets (sorted) are counted; everything comes from the indexes and columns.
+vector<GroupStats> DiskDatabase::groupStats(const MultiValueHashTable<StringCode, FileOffset>& index, const vector<FileOffset>* within) {
+    ensureIndexes();
+    vector<GroupStats> groups;
+    
+    for (const auto& key : index.getAllKeys()) {
+        GroupStats group;
+        group.key = dictionary.value(key);
+    
+        const vector<FileOffset>* offsets = index.getValues(key);
+        float rating, price;
+        for (const auto& offset : *offsets) {
+            if (within && !binary_search(within->begin(), within->end(), offset)) {
+                continue;
+            }
+            group.count++;
+            if (columns.lookup(offset, rating, price)) {
+                group.rating.add(rating);
+                group.price.add(price);
+            }
+        }
     
-    vector<Restaurant> results;
-    for (const auto& offset : offsets) {
-        results.push_back(readRestaurantFromDisk(offset));
+        if (group.count > 0) {
+            groups.push_back(group);
+        }
     }
     
-    return results;
+    sort(groups.begin(), groups.end(), [](const GroupStats& a, const GroupStats& b) {
+        return a.count != b.count ? a.count > b.count : a.key < b.key;
+    });
+    
+    return groups;
+}
+
+vector<GroupStats> DiskDatabase::getCuisineStats() {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return groupStats(cuisineIndex);
+}
+
+vector<GroupStats> DiskDatabase::getLocationStats() {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return groupStats(locationIndex);
+}
+
+// Tenant lists are kept sorted by offset, so callers binary-search them in place.
+const vector<FileOffset>& DiskDatabase::tenantOffsets(const string& tenant) {
+    static const vector<FileOffset> none;
+    ensureIndexes();
+    const vector<FileOffset>* offsets = tenantIndex.getValues(tenant);
+    return offsets ? *offsets : none;
+}
+
+KeyStats<float> DiskDatabase::getTenantFieldStats(const string& tenant, SortField field) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    
+    KeyStats<float> stats;
+    float rating, price;
+    for (const auto& offset : tenantOffsets(tenant)) {
+        if (columns.lookup(offset, rating, price)) {
+            stats.add(field == SORT_BY_PRICE ? price : rating);
+        }
+    }
+    return stats;
+}
+
+vector<GroupStats> DiskDatabase::getTenantCuisineStats(const string& tenant) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return groupStats(cuisineIndex, &tenantOffsets(tenant));
+}
+
+vector<GroupStats> DiskDatabase::getTenantLocationStats(const string& tenant) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return groupStats(locationIndex, &tenantOffsets(tenant));
 }
 
 Restaurant DiskDatabase::getRestaurant(const string& id) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
+    
     FileOffset* offsetPtr = idIndex.get(id);
     
     if (!offsetPtr) {
@@ -342,8 +2520,11 @@ Restaurant DiskDatabase::getRestaurant(const string& id) {
 }
 
 void DiskDatabase::displayAll() {
-    ifstream file(dataFilePath, ios::binary);
-    if (!file) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
+    
+    RecordScanner scanner(dataFilePath);
+    if (!scanner.isOpen()) {
         cout << "\nNo restaurants in database." << endl;
         return;
     }
@@ -352,80 +2533,163 @@ void DiskDatabase::displayAll() {
     
     cout << "  ALL RESTAURANTS:" << endl;
     
-    while (file.good() && file.peek() != EOF) {
-        FileOffset offset = file.tellg();
-        file.close();
-        
-        Restaurant r = readRestaurantFromDisk(offset);
-        if (r.restaurantId.empty()) break;
-        
+    FileOffset offset;
+    FrameHeader header;
+    const char* payload;
+    
+    while (scanner.next(offset, header, payload)) {
+        if (header.type != RECORD_RESTAURANT) {
+            continue;
+        }
+    
+        Restaurant r;
+        ByteReader reader(payload, header.length);
+        if (!decodeRestaurant(reader, dictionary, r) || !isLiveRecord(r.restaurantId, offset)) {
+            continue;
+        }
+    
         r.display();
         count++;
-        
-        file.open(dataFilePath, ios::binary);
-        file.seekg(offset);
-        
-        readString(file);
-        readString(file);
-        readString(file);
-        readStringVector(file);
-        float temp;
-        file.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-        file.read(reinterpret_cast<char*>(&temp), sizeof(temp));
-        readDishVector(file);
-        time_t t;
-        file.read(reinterpret_cast<char*>(&t), sizeof(t));
-        int v;
-        file.read(reinterpret_cast<char*>(&v), sizeof(v));
-        readString(file);
     }
     
-    file.close();
-    
     cout << "\nTotal: " << count << " restaurants" << endl;
 }
 
-int DiskDatabase::getTotalRestaurants() const {
-    return nextId - 1;
+bool DiskDatabase::indexesReady() const {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    return indexState == INDEX_READY;
+}
+
+int DiskDatabase::getTotalRestaurants() {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
+    return idIndex.getSize();
+}
+
+int DiskDatabase::getTenantRestaurantCount(const string& tenant) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
+    return tenantIndex.getCount(tenant);
+}
+
+vector<string> DiskDatabase::getTenants() {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
+    
+    vector<string> tenants;
+    for (const auto& key : tenantIndex.getAllKeys()) {
+        if (tenantIndex.getCount(key) > 0) {
+            tenants.push_back(key);
+        }
+    }
+    sort(tenants.begin(), tenants.end());
+    return tenants;
 }
 vector<Restaurant> DiskDatabase::getAllRestaurants() {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
+    
     vector<Restaurant> restaurants;
     
-    ifstream file(dataFilePath, ios::binary);
-    if (!file.good()) {
+    RecordScanner scanner(dataFilePath);
+    if (!scanner.isOpen()) {
         cout << "  File not found: " << dataFilePath << endl;
         return restaurants;
     }
     
     cout << "  Reading from: " << dataFilePath << endl;
     
-    while (file.good() && file.peek() != EOF) {
-        FileOffset offset = file.tellg();
-        
+    FileOffset offset;
+    FrameHeader header;
+    const char* payload;
+    
+    while (scanner.next(offset, header, payload)) {
+        if (header.type != RECORD_RESTAURANT) {
+            continue;
+        }
+    
         Restaurant r;
-        r.restaurantId = readString(file);
-        if (r.restaurantId.empty()) break;
-        
-        r.name = readString(file);
-        r.location = readString(file);
-        r.cuisineTypes = readStringVector(file);
-        
-        file.read(reinterpret_cast<char*>(&r.overallRating), sizeof(r.overallRating));
-        file.read(reinterpret_cast<char*>(&r.averagePrice), sizeof(r.averagePrice));
-        
-        r.dishes = readDishVector(file);
-        
-        file.read(reinterpret_cast<char*>(&r.lastVisitDate), sizeof(r.lastVisitDate));
-        file.read(reinterpret_cast<char*>(&r.totalVisits), sizeof(r.totalVisits));
-        
-        r.notes = readString(file);
-        
+        ByteReader reader(payload, header.length);
+        if (!decodeRestaurant(reader, dictionary, r) || !isLiveRecord(r.restaurantId, offset)) {
+            continue;
+        }
+    
         restaurants.push_back(r);
-        
-        cout << "    Read: " << r.name << " (ID: " << r.restaurantId << ")" << endl;
     }
     
-    file.close();
     cout << "  Total restaurants read: " << restaurants.size() << endl;
     return restaurants;
+}
+
+RestaurantPage DiskDatabase::getRestaurantPage(const string& cursor, int limit, const string& tenant) {
+    lock_guard<recursive_mutex> lock(dbMutex);
+    ensureIndexes();
+    
+    RestaurantPage page;
+    FileOffset start = FILE_HEADER_SIZE;
+    
+    if (!cursor.empty() && cursor != "0") {
+        uint64_t generation;
+        long long offset;
+        char dot;
+        stringstream token(cursor);
+        if (!(token >> generation >> dot >> offset) || dot != '.' || generation != fileId || offset < (long long)FILE_HEADER_SIZE) {
+            page.valid = false;
+            return page;
+        }
+        start = offset;
+    }
+    
+    // A tenant pages through its own offsets instead of scanning everyone else's records.
+    if (!tenant.empty()) {
+        const vector<FileOffset>& offsets = tenantOffsets(tenant);
+        auto first = lower_bound(offsets.begin(), offsets.end(), start);
+        size_t available = offsets.end() - first;
+        size_t take = limit > 0 ? min(available, (size_t)limit) : 0;
+    
+        page.restaurants = fetchRestaurants(vector<FileOffset>(first, first + take));
+        if (take > 0 && take < available) {
+            page.nextCursor = to_string(fileId) + "." + to_string(*(first + take - 1) + 1);
+        }
+        return page;
+    }
+    
+    // A cursor inside a compressed block resumes from the block and skips the records already returned.
+    FileOffset scanStart = start;
+    uint32_t slot;
+    blockIndex.find(start, scanStart, slot);
+    
+    RecordScanner scanner(dataFilePath, scanStart);
+    if (!scanner.isOpen() || limit <= 0) {
+        return page;
+    }
+    
+    FileOffset offset;
+    FrameHeader header;
+    const char* payload;
+    
+    while ((int)page.restaurants.size() < limit && scanner.next(offset, header, payload)) {
+        if (header.type != RECORD_RESTAURANT || offset < start) {
+            continue;
+        }
+    
+        Restaurant r;
+        ByteReader reader(payload, header.length);
+        if (!decodeRestaurant(reader, dictionary, r) || !isLiveRecord(r.restaurantId, offset)) {
+            continue;
+        }
+    
+        page.restaurants.push_back(r);
+    }
+    
+    if (scanner.isCorrupt() && scanner.position() == scanStart) {
+        page.valid = false;
+        return page;
+    }
+    
+    if ((int)page.restaurants.size() == limit && scanner.position() < getDataFileLength()) {
+        page.nextCursor = to_string(fileId) + "." + to_string(scanner.position());
+    }
+    
+    return page;
 }
\ No newline at end of file
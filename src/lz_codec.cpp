@@ -0,0 +1,148 @@
+#include "../include/lz_codec.h"
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+// Each sequence is [token][extra literal length][literals][uint16 match offset][extra match length].
+// The token's high nibble is the literal count and its low nibble the match length past LZ_MIN_MATCH;
+// a nibble of 15 continues in bytes of 255. The final sequence carries literals only.
+
+static uint32_t read32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t hashOf(uint32_t value) {
+    return (value * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static void writeLength(string& out, size_t length) {
+    while (length >= 255) {
+        out.push_back((char)255);
+        length -= 255;
+    }
+    out.push_back((char)length);
+}
+
+static bool readLength(const char* data, size_t length, size_t& pos, size_t& value) {
+    uint8_t byte;
+    do {
+        if (pos >= length) {
+            return false;
+        }
+        byte = (uint8_t)data[pos++];
+        value += byte;
+    } while (byte == 255);
+    return true;
+}
+
+static void emitSequence(string& out, const char* literals, size_t literalCount, size_t offset, size_t matchLength) {
+    size_t extraMatch = matchLength > 0 ? matchLength - LZ_MIN_MATCH : 0;
+    uint8_t token = (uint8_t)((min(literalCount, (size_t)15) << 4) | min(extraMatch, (size_t)15));
+    out.push_back((char)token);
+    
+    if (literalCount >= 15) {
+        writeLength(out, literalCount - 15);
+    }
+    out.append(literals, literalCount);
+    
+    if (matchLength == 0) {
+        return;
+    }
+    out.push_back((char)(offset & 0xFF));
+    out.push_back((char)(offset >> 8));
+    if (extraMatch >= 15) {
+        writeLength(out, extraMatch - 15);
+    }
+}
+
+void lzCompress(const char* data, size_t length, string& out) {
+    out.clear();
+    out.reserve(length / 2 + 16);
+    
+    vector<long long> table(1 << LZ_HASH_BITS, -1);
+    size_t anchor = 0;
+    size_t pos = 0;
+    
+    while (pos + LZ_MIN_MATCH <= length) {
+        uint32_t word = read32(data + pos);
+        uint32_t slot = hashOf(word);
+        long long candidate = table[slot];
+        table[slot] = pos;
+    
+        if (candidate < 0 || pos - candidate > LZ_MAX_OFFSET || read32(data + candidate) != word) {
+            pos++;
+            continue;
+        }
+    
+        size_t matchLength = LZ_MIN_MATCH;
+        while (pos + matchLength < length && data[candidate + matchLength] == data[pos + matchLength]) {
+            matchLength++;
+        }
+    
+        emitSequence(out, data + anchor, pos - anchor, pos - candidate, matchLength);
+        pos += matchLength;
+        anchor = pos;
+    }
+    
+    emitSequence(out, data + anchor, length - anchor, 0, 0);
+}
+
+// Every length and offset is checked, so a damaged block fails instead of reading or writing out of bounds.
+bool lzDecompress(const char* data, size_t length, size_t rawLength, string& out) {
+    out.resize(rawLength);
+    char* dest = &out[0];
+    size_t written = 0;
+    size_t pos = 0;
+    
+    while (pos < length) {
+        uint8_t token = (uint8_t)data[pos++];
+    
+        size_t literals = token >> 4;
+        if (literals == 15 && !readLength(data, length, pos, literals)) {
+            return false;
+        }
+        if (literals > length - pos || literals > rawLength - written) {
+            return false;
+        }
+        memcpy(dest + written, data + pos, literals);
+        pos += literals;
+        written += literals;
+    
+        if (written == rawLength) {
+            return true;
+        }
+        if (length - pos < 2) {
+            return false;
+        }
+    
+        size_t offset = (uint8_t)data[pos] | ((size_t)(uint8_t)data[pos + 1] << 8);
+        pos += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !readLength(data, length, pos, matchLength)) {
+            return false;
+        }
+        matchLength += LZ_MIN_MATCH;
+    
+        if (offset == 0 || offset > written || matchLength > rawLength - written) {
+            return false;
+        }
+    
+        // Overlapping matches repeat the bytes just written, so they are copied forward one byte at a time.
+        char* from = dest + written - offset;
+        if (offset >= matchLength) {
+            memcpy(dest + written, from, matchLength);
+        } else {
+            for (size_t i = 0; i < matchLength; i++) {
+                dest[written + i] = from[i];
+            }
+        }
+        written += matchLength;
+    }
+    
+    return written == rawLength;
+}
@@ -0,0 +1,28 @@
+#include <iostream>
+#include <string>
+#include "../include/storage_engine.h"
+
+using namespace std;
+
+// Imports every data/users/user_<name>.dat file into the shared data file.
+// Safe to run again: a record that was already imported is superseded by the new copy.
+int main(int argc, char* argv[]) {
+    string userDir = argc > 1 ? argv[1] : USER_DATA_DIR;
+    string sharedFile = argc > 2 ? argv[2] : SHARED_DATA_FILE;
+    
+    cout << "  FOOD SPOT MIGRATION" << endl;
+    cout << "  From: " << userDir << endl;
+    cout << "  To:   " << sharedFile << endl;
+    
+    StorageEngine engine(sharedFile);
+    int imported = engine.importUserDirectory(userDir);
+    
+    vector<string> users = engine.getUsers();
+    for (const auto& userID : users) {
+        cout << "   • " << userID << ": " << engine.getRestaurantCount(userID) << " restaurants" << endl;
+    }
+    
+    cout << "Shared database holds " << engine.getDatabase().getTotalRestaurants() << " restaurants for "
+         << users.size() << " users (" << imported << " imported)" << endl;
+    return 0;
+}
@@ -1,13 +1,12 @@
 #include "../include/recommendation_system.h"
 #include "../include/disk_database.h"
 #include <iostream>
-#include <fstream>
 #include <algorithm>
 
 using namespace std;
 
-RecommendationSystem::RecommendationSystem(UserManager* um)
-    : userManager(um) {
+RecommendationSystem::RecommendationSystem(UserManager* um, StorageEngine* engine)
+    : userManager(um), storage(engine) {
     cout << "Initializing Recommendation System..." << endl;
 }
 
@@ -59,84 +58,17 @@ float RecommendationSystem::calculateScore(const Restaurant& restaurant,
 }
 
 vector<Restaurant> RecommendationSystem::loadUserRestaurants(const string& userID) {
-    vector<Restaurant> restaurants;
+    if (storage) {
+        return storage->getUserRestaurants(userID);
+    }
     
     string username = userID.substr(5); 
     
     string dbPath = "data/users/user_" + username + ".dat";
     
-    ifstream file(dbPath, ios::binary);
-    if (!file.good()) {
-        return restaurants;
-    }
-
-    while (file.good() && file.peek() != EOF) {
-        Restaurant r;
-        
-        try {
-            int len;
-            file.read(reinterpret_cast<char*>(&len), sizeof(len));
-            if (len <= 0 || len > 1000) break;
-            r.restaurantId.resize(len);
-            file.read(&r.restaurantId[0], len);
-            
-            file.read(reinterpret_cast<char*>(&len), sizeof(len));
-            if (len <= 0 || len > 1000) break;
-            r.name.resize(len);
-            file.read(&r.name[0], len);
-            
-            file.read(reinterpret_cast<char*>(&len), sizeof(len));
-            if (len <= 0 || len > 1000) break;
-            r.location.resize(len);
-            file.read(&r.location[0], len);
-            
-            int cuisineCount;
-            file.read(reinterpret_cast<char*>(&cuisineCount), sizeof(cuisineCount));
-            for (int i = 0; i < cuisineCount && i < 20; i++) {
-                file.read(reinterpret_cast<char*>(&len), sizeof(len));
-                if (len <= 0 || len > 1000) break;
-                string cuisine(len, ' ');
-                file.read(&cuisine[0], len);
-                r.cuisineTypes.push_back(cuisine);
-            }
-            
-            file.read(reinterpret_cast<char*>(&r.overallRating), sizeof(r.overallRating));
-            file.read(reinterpret_cast<char*>(&r.averagePrice), sizeof(r.averagePrice));
-            
-            int dishCount;
-            file.read(reinterpret_cast<char*>(&dishCount), sizeof(dishCount));
-            for (int i = 0; i < dishCount && i < 50; i++) {
-                Dish dish;
-                
-                file.read(reinterpret_cast<char*>(&len), sizeof(len));
-                if (len <= 0 || len > 1000) break;
-                dish.dishName.resize(len);
-                file.read(&dish.dishName[0], len);
-                
-                file.read(reinterpret_cast<char*>(&dish.rating), sizeof(dish.rating));
-                file.read(reinterpret_cast<char*>(&dish.price), sizeof(dish.price));
-                
-                r.dishes.push_back(dish);
-            }
-            
-            file.read(reinterpret_cast<char*>(&r.lastVisitDate), sizeof(r.lastVisitDate));
-            file.read(reinterpret_cast<char*>(&r.totalVisits), sizeof(r.totalVisits));
-            
-            file.read(reinterpret_cast<char*>(&len), sizeof(len));
-            if (len > 0 && len < 1000) {
-                r.notes.resize(len);
-                file.read(&r.notes[0], len);
-            }
-            
-            restaurants.push_back(r);
-            
-        } catch (...) {
-            break;
-        }
-    }
-    
-    file.close();
-    return restaurants;
+    // Without a storage engine each user keeps their own data file, the same one main_multiuser opens for them.
+    // It is only read here: opening it as a DiskDatabase would migrate it and write index files.
+    return readRestaurantFile(dbPath);
 }
 
 vector<Restaurant> RecommendationSystem::loadFriendsRestaurants(const string& userID) {
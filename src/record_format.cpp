@@ -0,0 +1,438 @@
+#include "../include/record_format.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <unordered_map>
+
+using namespace std;
+
+const size_t SCAN_BLOCK_SIZE = 64 * 1024;
+
+struct CrcTable {
+    uint32_t entries[256];
+    
+    constexpr CrcTable() : entries() {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[i] = c;
+        }
+    }
+};
+
+// Built at compile time, so rebuild workers and the background index thread can all checksum at once.
+static constexpr CrcTable CRC_TABLE;
+
+uint32_t crc32(const char* data, size_t length) {
+    const uint32_t* table = CRC_TABLE.entries;
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ (uint8_t)data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+void appendFileHeader(string& out) {
+    out.append(DATA_FILE_MAGIC, 4);
+    ByteWriter writer(out);
+    writer.write(DATA_FORMAT_VERSION);
+}
+
+bool checkFileHeader(const char* data, size_t size) {
+    return fileFormatVersion(data, size) == DATA_FORMAT_VERSION;
+}
+
+uint32_t fileFormatVersion(const char* data, size_t size) {
+    if (size < FILE_HEADER_SIZE || memcmp(data, DATA_FILE_MAGIC, 4) != 0) {
+        return 0;
+    }
+    uint32_t version;
+    memcpy(&version, data + 4, sizeof(version));
+    return version;
+}
+
+void appendFileId(string& out, uint64_t id) {
+    string payload;
+    ByteWriter writer(payload);
+    writer.write(id);
+    appendFrame(out, RECORD_FILE_ID, payload);
+}
+
+// Files written before ids existed, or whose first frame is not an intact id, read as 0.
+uint64_t readFileId(const char* data, size_t size) {
+    FrameHeader header;
+    if (!readFrameHeader(data, size, FILE_HEADER_SIZE, header) || header.type != RECORD_FILE_ID ||
+        header.length != sizeof(uint64_t) || size - FILE_HEADER_SIZE - FRAME_HEADER_SIZE < sizeof(uint64_t)) {
+        return 0;
+    }
+    
+    const char* payload = data + FILE_HEADER_SIZE + FRAME_HEADER_SIZE;
+    if (crc32(payload, header.length) != header.checksum) {
+        return 0;
+    }
+    
+    uint64_t id;
+    memcpy(&id, payload, sizeof(id));
+    return id;
+}
+
+void appendFrame(string& out, RecordType type, const string& payload) {
+    ByteWriter writer(out);
+    uint32_t length = payload.size();
+    uint8_t reserved[3] = {0, 0, 0};
+    
+    writer.write(length);
+    writer.write((uint8_t)type);
+    writer.write(reserved);
+    writer.write(crc32(payload.data(), payload.size()));
+    out.append(payload);
+}
+
+bool readFrameHeader(const char* data, size_t size, size_t pos, FrameHeader& header) {
+    if (pos > size || size - pos < FRAME_HEADER_SIZE) {
+        return false;
+    }
+    
+    memcpy(&header.length, data + pos, sizeof(header.length));
+    header.type = (uint8_t)data[pos + 4];
+    memcpy(&header.checksum, data + pos + 8, sizeof(header.checksum));
+    
+    return header.type != 0 && header.length <= MAX_FRAME_PAYLOAD;
+}
+
+bool encodeRestaurant(const Restaurant& r, const StringDictionary& dictionary, string& out) {
+    ByteWriter writer(out);
+    
+    StringCode location = dictionary.lookup(r.location);
+    if (location == NO_STRING_CODE) {
+        return false;
+    }
+    
+    writer.writeString(r.restaurantId);
+    writer.writeString(r.name);
+    writer.write(location);
+    
+    writer.write((int)r.cuisineTypes.size());
+    for (const auto& cuisine : r.cuisineTypes) {
+        StringCode code = dictionary.lookup(cuisine);
+        if (code == NO_STRING_CODE) {
+            return false;
+        }
+        writer.write(code);
+    }
+    
+    writer.write(r.overallRating);
+    writer.write(r.averagePrice);
+    
+    writer.write((int)r.dishes.size());
+    for (const auto& dish : r.dishes) {
+        writer.writeString(dish.dishName);
+        writer.write(dish.rating);
+        writer.write(dish.price);
+    }
+    
+    writer.write(r.lastVisitDate);
+    writer.write(r.totalVisits);
+    
+    writer.writeString(r.notes);
+    return true;
+}
+
+bool decodeRestaurant(ByteReader& reader, const StringDictionary& dictionary, Restaurant& r) {
+    r.restaurantId = reader.readString();
+    r.name = reader.readString();
+    
+    StringCode location = reader.read<StringCode>();
+    bool known = location < dictionary.nextCode();
+    r.location = dictionary.value(location);
+    
+    int cuisineCount = reader.read<int>();
+    for (int i = 0; i < cuisineCount && reader.ok; i++) {
+        StringCode code = reader.read<StringCode>();
+        known = known && code < dictionary.nextCode();
+        r.cuisineTypes.push_back(dictionary.value(code));
+    }
+    
+    r.overallRating = reader.read<float>();
+    r.averagePrice = reader.read<float>();
+    
+    int dishCount = reader.read<int>();
+    for (int i = 0; i < dishCount && reader.ok; i++) {
+        Dish dish;
+        dish.dishName = reader.readString();
+        dish.rating = reader.read<float>();
+        dish.price = reader.read<float>();
+        r.dishes.push_back(dish);
+    }
+    
+    r.lastVisitDate = reader.read<time_t>();
+    r.totalVisits = reader.read<int>();
+    
+    r.notes = reader.readString();
+    
+    return reader.ok && known && !r.restaurantId.empty();
+}
+
+void encodeDictionaryEntry(StringCode code, const string& value, string& out) {
+    ByteWriter writer(out);
+    writer.write(code);
+    writer.writeString(value);
+}
+
+bool decodeDictionaryEntry(ByteReader& reader, StringCode& code, string& value) {
+    code = reader.read<StringCode>();
+    value = reader.readString();
+    return reader.ok;
+}
+
+void encodeBlock(const string& frames, uint32_t records, int maxIdNumber, string& out) {
+    string compressed;
+    lzCompress(frames.data(), frames.size(), compressed);
+    
+    ByteWriter writer(out);
+    writer.write((uint32_t)frames.size());
+    writer.write(records);
+    writer.write((int32_t)maxIdNumber);
+    out.append(compressed);
+    
+    // Trailing padding is never reached by the decompressor, which stops at the raw length.
+    while (FRAME_HEADER_SIZE + out.size() <= records) {
+        out.push_back('\0');
+    }
+}
+
+bool readBlockHeader(const char* payload, size_t length, BlockHeader& header) {
+    ByteReader reader(payload, length);
+    header.rawLength = reader.read<uint32_t>();
+    header.records = reader.read<uint32_t>();
+    header.maxIdNumber = reader.read<int32_t>();
+    return reader.ok && header.records > 0 && FRAME_HEADER_SIZE + length > header.records;
+}
+
+bool decodeBlock(const char* payload, size_t length, string& frames) {
+    BlockHeader header;
+    if (!readBlockHeader(payload, length, header) || header.rawLength > MAX_FRAME_PAYLOAD) {
+        return false;
+    }
+    return lzDecompress(payload + BLOCK_HEADER_SIZE, length - BLOCK_HEADER_SIZE, header.rawLength, frames);
+}
+
+// Frames inside a block are not checksummed again; the block frame's checksum already covers them.
+bool nextBlockFrame(const string& frames, size_t& pos, FrameHeader& header, const char*& payload) {
+    if (!readFrameHeader(frames.data(), frames.size(), pos, header) || frames.size() - pos - FRAME_HEADER_SIZE < header.length) {
+        return false;
+    }
+    
+    payload = frames.data() + pos + FRAME_HEADER_SIZE;
+    pos += FRAME_HEADER_SIZE + header.length;
+    return true;
+}
+
+bool decodeRestaurant(ByteReader& reader, Restaurant& r) {
+    r.restaurantId = reader.readString();
+    r.name = reader.readString();
+    r.location = reader.readString();
+    
+    int cuisineCount = reader.read<int>();
+    for (int i = 0; i < cuisineCount && reader.ok; i++) {
+        r.cuisineTypes.push_back(reader.readString());
+    }
+    
+    r.overallRating = reader.read<float>();
+    r.averagePrice = reader.read<float>();
+    
+    int dishCount = reader.read<int>();
+    for (int i = 0; i < dishCount && reader.ok; i++) {
+        Dish dish;
+        dish.dishName = reader.readString();
+        dish.rating = reader.read<float>();
+        dish.price = reader.read<float>();
+        r.dishes.push_back(dish);
+    }
+    
+    r.lastVisitDate = reader.read<time_t>();
+    r.totalVisits = reader.read<int>();
+    
+    r.notes = reader.readString();
+    
+    return reader.ok && !r.restaurantId.empty();
+}
+
+RecordScanner::RecordScanner(const string& filepath, long long startOffset)
+    : bufferPos(0), bufferStart(startOffset), corrupt(false), eof(false), blockPos(0), blockOffset(-1), blockSlot(0), blockRecords(0) {
+    file.open(filepath, ios::binary);
+    if (file) {
+        file.seekg(startOffset);
+    }
+}
+
+bool RecordScanner::fill(size_t needed) {
+    if (buffer.size() - bufferPos >= needed) {
+        return true;
+    }
+    
+    buffer.erase(0, bufferPos);
+    bufferStart += bufferPos;
+    bufferPos = 0;
+    
+    while (buffer.size() < needed && !eof) {
+        size_t chunk = max(SCAN_BLOCK_SIZE, needed - buffer.size());
+        size_t oldSize = buffer.size();
+        buffer.resize(oldSize + chunk);
+        file.read(&buffer[oldSize], chunk);
+        size_t got = file.gcount();
+        buffer.resize(oldSize + got);
+        if (got < chunk) {
+            eof = true;
+        }
+    }
+    
+    return buffer.size() >= needed;
+}
+
+bool RecordScanner::next(long long& offset, FrameHeader& header, const char*& payload) {
+    if (!file.is_open() || corrupt) {
+        return false;
+    }
+    
+    if (blockOffset >= 0 && blockSlot < blockRecords) {
+        return nextInBlock(offset, header, payload);
+    }
+    blockOffset = -1;
+    
+    if (!fill(FRAME_HEADER_SIZE)) {
+        if (buffer.size() > bufferPos) {
+            corrupt = true;
+        }
+        return false;
+    }
+    
+    offset = position();
+    
+    if (!readFrameHeader(buffer.data(), buffer.size(), bufferPos, header) || !fill(FRAME_HEADER_SIZE + header.length)) {
+        corrupt = true;
+        return false;
+    }
+    
+    payload = buffer.data() + bufferPos + FRAME_HEADER_SIZE;
+    if (crc32(payload, header.length) != header.checksum) {
+        corrupt = true;
+        return false;
+    }
+    
+    bufferPos += FRAME_HEADER_SIZE + header.length;
+    if (header.type != RECORD_BLOCK) {
+        return true;
+    }
+    
+    BlockHeader blockHeader;
+    if (!readBlockHeader(payload, header.length, blockHeader) || !decodeBlock(payload, header.length, block)) {
+        bufferPos -= FRAME_HEADER_SIZE + header.length;
+        corrupt = true;
+        return false;
+    }
+    
+    blockPos = 0;
+    blockOffset = offset;
+    blockSlot = 0;
+    blockRecords = blockHeader.records;
+    return nextInBlock(offset, header, payload);
+}
+
+// A block that decompresses but holds the wrong frames counts as corrupt from the block's own offset.
+bool RecordScanner::nextInBlock(long long& offset, FrameHeader& header, const char*& payload) {
+    if (!nextBlockFrame(block, blockPos, header, payload) || (blockSlot + 1 == blockRecords && blockPos != block.size())) {
+        blockSlot = 0;
+        corrupt = true;
+        return false;
+    }
+    
+    offset = blockOffset + blockSlot;
+    blockSlot++;
+    return true;
+}
+
+long long RecordScanner::position() const {
+    if (blockOffset >= 0 && blockSlot < blockRecords) {
+        return blockOffset + blockSlot;
+    }
+    return bufferStart + (long long)bufferPos;
+}
+
+// Later versions of an id replace earlier ones and tombstones remove it, the same as when the file is indexed.
+vector<Restaurant> readRestaurantFile(const string& path) {
+    vector<Restaurant> records;
+    unordered_map<string, size_t> latest;
+    
+    ifstream file(path, ios::binary);
+    char header[FILE_HEADER_SIZE];
+    file.read(header, sizeof(header));
+    uint32_t version = fileFormatVersion(header, file.gcount());
+    
+    if (version == 0) {
+        file.clear();
+        file.seekg(0);
+        string legacy((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    
+        ByteReader reader(legacy.data(), legacy.size());
+        while (reader.pos < legacy.size()) {
+            Restaurant r;
+            if (!decodeRestaurant(reader, r)) {
+                break;
+            }
+            latest[r.restaurantId] = records.size();
+            records.push_back(r);
+        }
+    } else if (version == PLAIN_STRINGS_FORMAT_VERSION || version == DATA_FORMAT_VERSION) {
+        file.close();
+    
+        RecordScanner scanner(path);
+        long long offset;
+        FrameHeader frame;
+        const char* payload;
+        StringDictionary strings;
+    
+        while (scanner.next(offset, frame, payload)) {
+            ByteReader reader(payload, frame.length);
+    
+            if (frame.type == RECORD_TOMBSTONE) {
+                latest.erase(reader.readString());
+                continue;
+            }
+    
+            if (frame.type == RECORD_DICTIONARY) {
+                StringCode code;
+                string value;
+                if (decodeDictionaryEntry(reader, code, value)) {
+                    strings.define(code, value);
+                }
+                continue;
+            }
+    
+            if (frame.type != RECORD_RESTAURANT) {
+                continue;
+            }
+    
+            Restaurant r;
+            bool decoded = version == PLAIN_STRINGS_FORMAT_VERSION ? decodeRestaurant(reader, r) : decodeRestaurant(reader, strings, r);
+            if (decoded) {
+                latest[r.restaurantId] = records.size();
+                records.push_back(r);
+            }
+        }
+    } else {
+        cerr << "Error. unsupported data format version in " << path << endl;
+    }
+    
+    vector<Restaurant> restaurants;
+    for (size_t i = 0; i < records.size(); i++) {
+        auto it = latest.find(records[i].restaurantId);
+        if (it != latest.end() && it->second == i) {
+            restaurants.push_back(records[i]);
+        }
+    }
+    return restaurants;
+}
@@ -0,0 +1,109 @@
+#include "../include/restaurant_view.h"
+
+using namespace std;
+
+static string_view readStringView(ByteReader& reader) {
+    int len = reader.read<int>();
+    if (len < 0) {
+        reader.ok = false;
+        return string_view();
+    }
+    if (len == 0) {
+        return string_view();
+    }
+    const char* bytes = reader.readBytes(len);
+    return bytes ? string_view(bytes, len) : string_view();
+}
+
+bool RestaurantView::parse(ByteReader& reader, const StringDictionary& strings) {
+    dictionary = &strings;
+    restaurantId = readStringView(reader);
+    name = readStringView(reader);
+    locationCode = reader.read<StringCode>();
+    location = strings.value(locationCode);
+    
+    cuisineCount = reader.read<int>();
+    size_t cuisineStart = reader.pos;
+    if (cuisineCount < 0 || !reader.readBytes((size_t)cuisineCount * sizeof(StringCode))) {
+        reader.ok = false;
+    }
+    cuisineData = reader.data + cuisineStart;
+    cuisineBytes = reader.pos - cuisineStart;
+    if (reader.ok && cuisineCount > 0) {
+        StringCode first;
+        memcpy(&first, cuisineData, sizeof(first));
+        cuisine = strings.value(first);
+    }
+    
+    overallRating = reader.read<float>();
+    averagePrice = reader.read<float>();
+    
+    dishCount = reader.read<int>();
+    size_t dishStart = reader.pos;
+    for (int i = 0; i < dishCount && reader.ok; i++) {
+        readStringView(reader);
+        reader.readBytes(sizeof(float) * 2);
+    }
+    dishData = reader.data + dishStart;
+    dishBytes = reader.pos - dishStart;
+    
+    lastVisitDate = reader.read<time_t>();
+    totalVisits = reader.read<int>();
+    
+    notes = readStringView(reader);
+    
+    return reader.ok && locationCode < strings.nextCode() && !restaurantId.empty();
+}
+
+string_view RestaurantView::firstCuisine() const {
+    return cuisine;
+}
+
+vector<string_view> RestaurantView::cuisines() const {
+    vector<string_view> result;
+    ByteReader reader(cuisineData, cuisineBytes);
+    for (int i = 0; i < cuisineCount && reader.ok; i++) {
+        result.push_back(dictionary->value(reader.read<StringCode>()));
+    }
+    return result;
+}
+
+bool RestaurantView::hasCuisine(StringCode code) const {
+    ByteReader reader(cuisineData, cuisineBytes);
+    for (int i = 0; i < cuisineCount && reader.ok; i++) {
+        if (reader.read<StringCode>() == code) {
+            return true;
+        }
+    }
+    return false;
+}
+
+vector<Dish> RestaurantView::dishes() const {
+    vector<Dish> result;
+    ByteReader reader(dishData, dishBytes);
+    for (int i = 0; i < dishCount && reader.ok; i++) {
+        Dish dish;
+        dish.dishName = string(readStringView(reader));
+        dish.rating = reader.read<float>();
+        dish.price = reader.read<float>();
+        result.push_back(dish);
+    }
+    return result;
+}
+
+Restaurant RestaurantView::materialize() const {
+    Restaurant r;
+    r.restaurantId = string(restaurantId);
+    r.name = string(name);
+    r.location = string(location);
+    for (const auto& cuisine : cuisines()) {
+        r.cuisineTypes.push_back(string(cuisine));
+    }
+    r.overallRating = overallRating;
+    r.averagePrice = averagePrice;
+    r.dishes = dishes();
+    r.lastVisitDate = lastVisitDate;
+    r.totalVisits = totalVisits;
+    r.notes = string(notes);
+    return r;
+}
@@ -6,10 +6,11 @@
 #include <sstream>
 #include <map>
 #include <algorithm>
+#include <chrono>
 #include <winsock2.h>
 #include <ws2tcpip.h>
 #include <windows.h>
-#include "../include/disk_database.h"
+#include "../include/storage_engine.h"
 #include "../include/user_manager.h"
 #include "../include/alert_system.h"
 #include "../include/recommendation_system.h"
@@ -21,7 +22,7 @@ using namespace std;
 UserManager* userManager = nullptr;
 AlertSystem* alertSystem = nullptr;
 RecommendationSystem* recommendationSystem = nullptr;
-map<string, DiskDatabase*> userDatabases;
+StorageEngine* storage = nullptr;
 
 string toJSON(const string& key, const string& value) {
     return "\"" + key + "\":\"" + value + "\"";
@@ -35,6 +36,46 @@ string toJSON(const string& key, float value) {
     return "\"" + key + "\":" + to_string(value);
 }
 
+void appendRestaurantJSON(string& json, const RestaurantView& r) {
+    json += "{\"id\":\"";
+    json += r.restaurantId;
+    json += "\",\"name\":\"";
+    json += r.name;
+    json += "\",\"location\":\"";
+    json += r.location;
+    json += "\",\"cuisine\":\"";
+    json += r.firstCuisine();
+    json += "\",\"rating\":" + to_string(r.overallRating);
+    json += ",\"price\":" + to_string(r.averagePrice);
+    json += ",\"notes\":\"";
+    json += r.notes;
+    json += "\"}";
+}
+
+void appendStatsJSON(string& json, const KeyStats<float>& stats) {
+    json += "{\"count\":" + to_string(stats.count);
+    json += ",\"min\":" + to_string(stats.min);
+    json += ",\"max\":" + to_string(stats.max);
+    json += ",\"avg\":" + to_string(stats.average());
+    json += "}";
+}
+
+void appendGroupStatsJSON(string& json, const vector<GroupStats>& groups) {
+    json += "[";
+    for (size_t i = 0; i < groups.size(); i++) {
+        json += "{\"name\":\"";
+        json += groups[i].key;
+        json += "\",\"count\":" + to_string(groups[i].count);
+        json += ",\"rating\":";
+        appendStatsJSON(json, groups[i].rating);
+        json += ",\"price\":";
+        appendStatsJSON(json, groups[i].price);
+        json += "}";
+        if (i < groups.size() - 1) json += ",";
+    }
+    json += "]";
+}
+
 bool initWinsock() {
     WSADATA wsaData;
     int result = WSAStartup(MAKEWORD(2, 2), &wsaData);
@@ -100,26 +141,11 @@ string handleCommand(const string& command) {
             cout << "  Rating: " << rating << endl;
             cout << "  Price: " << avgPrice << endl;
             
-            if (userDatabases.find(userID) == userDatabases.end()) {
-                string username = userID.substr(5);
-                string dbPath = "data/users/user_" + username + ".dat";
-                
-                #ifdef _WIN32
-                    system("if not exist data mkdir data");
-                    system("if not exist data\\users mkdir data\\users");
-                #else
-                    system("mkdir -p data/users");
-                #endif
-                
-                cout << "  Creating database at: " << dbPath << endl;
-                userDatabases[userID] = new DiskDatabase(dbPath);
-            }
-            
             vector<string> cuisines = {cuisine};
             vector<Dish> dishes;
             
-            string restID = userDatabases[userID]->addRestaurant(
-                name, location, cuisines, rating, avgPrice, dishes, notes
+            string restID = storage->addRestaurant(
+                userID, name, location, cuisines, rating, avgPrice, dishes, notes
             );
             
             cout << "  Restaurant ID returned: " << restID << endl;
@@ -145,60 +171,115 @@ string handleCommand(const string& command) {
                 "\",\"name\":\"" + name + "\"}";
         }
                 
-        else if (action == "GET_RESTAURANTS") 
-        {
+        else if (action == "BULK_ADD_RESTAURANTS") {
             string userID;
-            ss >> userID;
+            int count;
+            ss >> userID >> count;
             
-            cout << "\nDEBUG GET_RESTAURANTS:" << endl;
+            cout << "\n BULK_ADD_RESTAURANTS:" << endl;
             cout << "  User: " << userID << endl;
+            cout << "  Entries: " << count << endl;
             
-            if (userDatabases.find(userID) == userDatabases.end()) {
-                string username = userID.substr(5);
-                string dbPath = "data/users/user_" + username + ".dat";
+            vector<Restaurant> batch;
+            vector<string> cuisines;
+            
+            for (int i = 0; i < count; i++) {
+                string name, location, cuisine, notes;
+                float rating, avgPrice;
+                if (!(ss >> name >> location >> cuisine >> rating >> avgPrice >> notes)) {
+                    return "{\"status\":\"error\",\"message\":\"Malformed entry " + to_string(i) + "\"}";
+                }
                 
-                #ifdef _WIN32
-                    system("if not exist data mkdir data");
-                    system("if not exist data\\users mkdir data\\users");
-                #else
-                    system("mkdir -p data/users");
-                #endif
+                std::replace(name.begin(), name.end(), '_', ' ');
+                std::replace(location.begin(), location.end(), '_', ' ');
+                std::replace(cuisine.begin(), cuisine.end(), '_', ' ');
+                std::replace(notes.begin(), notes.end(), '_', ' ');
                 
-                cout << "  Creating new database: " << dbPath << endl;
-                userDatabases[userID] = new DiskDatabase(dbPath);
+                Restaurant r;
+                r.name = name;
+                r.location = location;
+                r.cuisineTypes = {cuisine};
+                r.overallRating = rating;
+                r.averagePrice = avgPrice;
+                r.notes = notes;
+                batch.push_back(r);
+                cuisines.push_back(cuisine);
+            }
+            
+            vector<string> restIDs = storage->addRestaurants(userID, batch);
+            
+            if (restIDs.size() != batch.size()) {
+                cout << "  ERROR: Failed to add batch!" << endl;
+                return "{\"status\":\"error\",\"message\":\"Failed to add restaurants\"}";
+            }
+            
+            recommendationSystem->updatePreferences(userID, cuisines);
+            userManager->updateRestaurantCount(userID, restIDs.size());
+            
+            string json = "{\"status\":\"success\",\"restaurantIDs\":[";
+            for (size_t i = 0; i < restIDs.size(); i++) {
+                json += "\"" + restIDs[i] + "\"";
+                if (i < restIDs.size() - 1) json += ",";
+            }
+            json += "],\"count\":" + to_string(restIDs.size()) + "}";
+            
+            return json;
+        }
+        
+        else if (action == "GET_RESTAURANTS") 
+        {
+            string userID, cursor;
+            int limit = 0;
+            ss >> userID >> cursor >> limit;
+            
+            // Without a cursor the whole history is returned, still read one page at a time.
+            bool paged = !cursor.empty();
+            if (!paged || limit <= 0) {
+                limit = 500;
             }
             
-            ifstream testFile("data/users/user_" + userID.substr(5) + ".dat");
-            if (!testFile.good()) {
-                cout << "  File doesn't exist yet" << endl;
-                return "{\"status\":\"success\",\"restaurants\":[]}";
+            cout << "\nDEBUG GET_RESTAURANTS:" << endl;
+            cout << "  User: " << userID << endl;
+            if (paged) {
+                cout << "  Cursor: " << cursor << ", limit: " << limit << endl;
             }
-            testFile.close();
             
-            int count = userDatabases[userID]->getTotalRestaurants();
+            int count = storage->getRestaurantCount(userID);
             cout << "  Database reports: " << count << " restaurants" << endl;
             
             try {
-                vector<Restaurant> restaurants = userDatabases[userID]->getAllRestaurants();
-                cout << "  Successfully read " << restaurants.size() << " restaurants" << endl;
-                
                 string json = "{\"status\":\"success\",\"restaurants\":[";
-                for (size_t i = 0; i < restaurants.size(); i++) {
-                    const auto& r = restaurants[i];
-                    cout << "    Restaurant " << i << ": " << r.name << endl;
+                int returned = 0;
+                string nextCursor = paged ? cursor : "";
+                
+                do {
+                    RestaurantPage page = storage->getRestaurantPage(userID, nextCursor, limit);
+                    if (!page.valid) {
+                        return "{\"status\":\"error\",\"message\":\"Cursor expired, restart from the beginning\"}";
+                    }
                     
-                    json += "{";
-                    json += "\"id\":\"" + r.restaurantId + "\",";
-                    json += "\"name\":\"" + r.name + "\",";
-                    json += "\"location\":\"" + r.location + "\",";
-                    json += "\"cuisine\":\"" + (r.cuisineTypes.empty() ? "" : r.cuisineTypes[0]) + "\",";
-                    json += "\"rating\":" + to_string(r.overallRating) + ",";
-                    json += "\"price\":" + to_string(r.averagePrice);
-                    json += "}";
-                    if (i < restaurants.size() - 1) json += ",";
+                    for (const auto& r : page.restaurants) {
+                        if (returned > 0) json += ",";
+                        json += "{";
+                        json += "\"id\":\"" + r.restaurantId + "\",";
+                        json += "\"name\":\"" + r.name + "\",";
+                        json += "\"location\":\"" + r.location + "\",";
+                        json += "\"cuisine\":\"" + (r.cuisineTypes.empty() ? "" : r.cuisineTypes[0]) + "\",";
+                        json += "\"rating\":" + to_string(r.overallRating) + ",";
+                        json += "\"price\":" + to_string(r.averagePrice);
+                        json += "}";
+                        returned++;
+                    }
+                    nextCursor = page.nextCursor;
+                } while (!paged && !nextCursor.empty());
+                
+                json += "],\"total\":" + to_string(count);
+                if (paged) {
+                    json += ",\"nextCursor\":\"" + nextCursor + "\"";
                 }
-                json += "]}";
+                json += "}";
                 
+                cout << "  Successfully read " << returned << " restaurants" << endl;
                 return json;
                 
             } catch (const exception& e) {
@@ -351,13 +432,12 @@ string handleCommand(const string& command) {
             cout << "  User: " << userID << endl;
             cout << "  Cuisine: " << cuisine << endl;
             
-            if (userDatabases.find(userID) == userDatabases.end()) {
-                cout << "  ERROR: User database not found" << endl;
-                return "{\"status\":\"error\",\"message\":\"User database not found\"}";
-            }
-            
-            vector<Restaurant> results = userDatabases[userID]->searchByCuisine(cuisine);
-            cout << "  Found " << results.size() << " restaurants" << endl;
+            auto searchStart = chrono::steady_clock::now();
+            RestaurantQuery q;
+            q.cuisine = cuisine;
+            vector<RestaurantView> results = storage->queryViews(userID, q);
+            long long searchMicros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - searchStart).count();
+            cout << "  Found " << results.size() << " restaurants in " << searchMicros << " us" << endl;
             
             string json = "{\"status\":\"success\",\"restaurants\":[";
             for (size_t i = 0; i < results.size(); i++) {
@@ -365,18 +445,10 @@ string handleCommand(const string& command) {
                 
                 cout << "    • " << r.name << " (Rating: " << r.overallRating << ")" << endl;
                 
-                json += "{";
-                json += "\"id\":\"" + r.restaurantId + "\",";
-                json += "\"name\":\"" + r.name + "\",";
-                json += "\"location\":\"" + r.location + "\",";
-                json += "\"cuisine\":\"" + (r.cuisineTypes.empty() ? "" : r.cuisineTypes[0]) + "\",";
-                json += "\"rating\":" + to_string(r.overallRating) + ",";
-                json += "\"price\":" + to_string(r.averagePrice) + ",";
-                json += "\"notes\":\"" + r.notes + "\"";
-                json += "}";
+                appendRestaurantJSON(json, r);
                 if (i < results.size() - 1) json += ",";
             }
-            json += "],\"count\":" + to_string(results.size()) + "}";
+            json += "],\"count\":" + to_string(results.size()) + ",\"elapsedUs\":" + to_string(searchMicros) + "}";
             
             return json;
         }
@@ -391,33 +463,23 @@ string handleCommand(const string& command) {
             cout << "  User: " << userID << endl;
             cout << "  Location: " << location << endl;
             
-            if (userDatabases.find(userID) == userDatabases.end()) {
-                cout << "  ERROR: User database not found" << endl;
-                return "{\"status\":\"error\",\"message\":\"User database not found\"}";
-            }
-            
-            vector<Restaurant> results = userDatabases[userID]->searchByLocation(location);
-            cout << "  Found " << results.size() << " restaurants" << endl;
+            auto searchStart = chrono::steady_clock::now();
+            RestaurantQuery q;
+            q.location = location;
+            vector<RestaurantView> results = storage->queryViews(userID, q);
+            long long searchMicros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - searchStart).count();
+            cout << "  Found " << results.size() << " restaurants in " << searchMicros << " us" << endl;
             
             string json = "{\"status\":\"success\",\"restaurants\":[";
             for (size_t i = 0; i < results.size(); i++) {
                 const auto& r = results[i];
                 
-                cout << "    • " << r.name << " (Cuisine: " 
-                    << (r.cuisineTypes.empty() ? "" : r.cuisineTypes[0]) << ")" << endl;
+                cout << "    • " << r.name << " (Cuisine: " << r.firstCuisine() << ")" << endl;
                 
-                json += "{";
-                json += "\"id\":\"" + r.restaurantId + "\",";
-                json += "\"name\":\"" + r.name + "\",";
-                json += "\"location\":\"" + r.location + "\",";
-                json += "\"cuisine\":\"" + (r.cuisineTypes.empty() ? "" : r.cuisineTypes[0]) + "\",";
-                json += "\"rating\":" + to_string(r.overallRating) + ",";
-                json += "\"price\":" + to_string(r.averagePrice) + ",";
-                json += "\"notes\":\"" + r.notes + "\"";
-                json += "}";
+                appendRestaurantJSON(json, r);
                 if (i < results.size() - 1) json += ",";
             }
-            json += "],\"count\":" + to_string(results.size()) + "}";
+            json += "],\"count\":" + to_string(results.size()) + ",\"elapsedUs\":" + to_string(searchMicros) + "}";
             
             return json;
         }
@@ -431,13 +493,12 @@ string handleCommand(const string& command) {
             cout << "  User: " << userID << endl;
             cout << "  Rating Range: " << minRating << " - " << maxRating << endl;
             
-            if (userDatabases.find(userID) == userDatabases.end()) {
-                cout << "  ERROR: User database not found" << endl;
-                return "{\"status\":\"error\",\"message\":\"User database not found\"}";
-            }
-            
-            vector<Restaurant> results = userDatabases[userID]->searchByRatingRange(minRating, maxRating);
-            cout << "  Found " << results.size() << " restaurants" << endl;
+            auto searchStart = chrono::steady_clock::now();
+            RestaurantQuery q;
+            q.setRating(minRating, maxRating);
+            vector<RestaurantView> results = storage->queryViews(userID, q);
+            long long searchMicros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - searchStart).count();
+            cout << "  Found " << results.size() << " restaurants in " << searchMicros << " us" << endl;
             
             string json = "{\"status\":\"success\",\"restaurants\":[";
             for (size_t i = 0; i < results.size(); i++) {
@@ -445,18 +506,10 @@ string handleCommand(const string& command) {
                 
                 cout << "    • " << r.name << " (Rating: " << r.overallRating << ")" << endl;
                 
-                json += "{";
-                json += "\"id\":\"" + r.restaurantId + "\",";
-                json += "\"name\":\"" + r.name + "\",";
-                json += "\"location\":\"" + r.location + "\",";
-                json += "\"cuisine\":\"" + (r.cuisineTypes.empty() ? "" : r.cuisineTypes[0]) + "\",";
-                json += "\"rating\":" + to_string(r.overallRating) + ",";
-                json += "\"price\":" + to_string(r.averagePrice) + ",";
-                json += "\"notes\":\"" + r.notes + "\"";
-                json += "}";
+                appendRestaurantJSON(json, r);
                 if (i < results.size() - 1) json += ",";
             }
-            json += "],\"count\":" + to_string(results.size()) + "}";
+            json += "],\"count\":" + to_string(results.size()) + ",\"elapsedUs\":" + to_string(searchMicros) + "}";
             
             return json;
         }
@@ -470,13 +523,12 @@ string handleCommand(const string& command) {
             cout << "  User: " << userID << endl;
             cout << "  Price Range: Rs. " << minPrice << " - " << maxPrice << endl;
             
-            if (userDatabases.find(userID) == userDatabases.end()) {
-                cout << "  ERROR: User database not found" << endl;
-                return "{\"status\":\"error\",\"message\":\"User database not found\"}";
-            }
-            
-            vector<Restaurant> results = userDatabases[userID]->searchByPriceRange(minPrice, maxPrice);
-            cout << "  Found " << results.size() << " restaurants" << endl;
+            auto searchStart = chrono::steady_clock::now();
+            RestaurantQuery q;
+            q.setPrice(minPrice, maxPrice);
+            vector<RestaurantView> results = storage->queryViews(userID, q);
+            long long searchMicros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - searchStart).count();
+            cout << "  Found " << results.size() << " restaurants in " << searchMicros << " us" << endl;
             
             string json = "{\"status\":\"success\",\"restaurants\":[";
             for (size_t i = 0; i < results.size(); i++) {
@@ -484,18 +536,107 @@ string handleCommand(const string& command) {
                 
                 cout << "    • " << r.name << " (Price: Rs. " << r.averagePrice << ")" << endl;
                 
-                json += "{";
-                json += "\"id\":\"" + r.restaurantId + "\",";
-                json += "\"name\":\"" + r.name + "\",";
-                json += "\"location\":\"" + r.location + "\",";
-                json += "\"cuisine\":\"" + (r.cuisineTypes.empty() ? "" : r.cuisineTypes[0]) + "\",";
-                json += "\"rating\":" + to_string(r.overallRating) + ",";
-                json += "\"price\":" + to_string(r.averagePrice) + ",";
-                json += "\"notes\":\"" + r.notes + "\"";
-                json += "}";
+                appendRestaurantJSON(json, r);
                 if (i < results.size() - 1) json += ",";
             }
-            json += "],\"count\":" + to_string(results.size()) + "}";
+            json += "],\"count\":" + to_string(results.size()) + ",\"elapsedUs\":" + to_string(searchMicros) + "}";
+            
+            return json;
+        }
+        
+        else if (action == "SEARCH_RATING_PRICE") {
+            string userID;
+            float minRating, maxRating, minPrice, maxPrice;
+            ss >> userID >> minRating >> maxRating >> minPrice >> maxPrice;
+            
+            cout << "\n SEARCH_RATING_PRICE:" << endl;
+            cout << "  User: " << userID << endl;
+            cout << "  Rating Range: " << minRating << " - " << maxRating << endl;
+            cout << "  Price Range: Rs. " << minPrice << " - " << maxPrice << endl;
+            
+            auto searchStart = chrono::steady_clock::now();
+            RestaurantQuery q;
+            q.setRating(minRating, maxRating);
+            q.setPrice(minPrice, maxPrice);
+            vector<RestaurantView> results = storage->queryViews(userID, q);
+            long long searchMicros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - searchStart).count();
+            cout << "  Found " << results.size() << " restaurants in " << searchMicros << " us" << endl;
+            
+            string json = "{\"status\":\"success\",\"restaurants\":[";
+            for (size_t i = 0; i < results.size(); i++) {
+                appendRestaurantJSON(json, results[i]);
+                if (i < results.size() - 1) json += ",";
+            }
+            json += "],\"count\":" + to_string(results.size()) + ",\"elapsedUs\":" + to_string(searchMicros) + "}";
+            
+            return json;
+        }
+        
+        else if (action == "QUERY") {
+            string userID, cuisine, location, minRating, maxRating, minPrice, maxPrice;
+            ss >> userID >> cuisine >> location >> minRating >> maxRating >> minPrice >> maxPrice;
+            
+            RestaurantQuery q;
+            if (cuisine != "*") {
+                std::replace(cuisine.begin(), cuisine.end(), '_', ' ');
+                q.cuisine = cuisine;
+            }
+            if (location != "*") {
+                std::replace(location.begin(), location.end(), '_', ' ');
+                q.location = location;
+            }
+            if (minRating != "*" && maxRating != "*") {
+                q.setRating(stof(minRating), stof(maxRating));
+            }
+            if (minPrice != "*" && maxPrice != "*") {
+                q.setPrice(stof(minPrice), stof(maxPrice));
+            }
+            
+            cout << "\n QUERY:" << endl;
+            cout << "  User: " << userID << endl;
+            cout << "  Cuisine: " << cuisine << ", Location: " << location << endl;
+            cout << "  Rating: " << minRating << " - " << maxRating << ", Price: " << minPrice << " - " << maxPrice << endl;
+            
+            auto searchStart = chrono::steady_clock::now();
+            vector<RestaurantView> results = storage->queryViews(userID, q);
+            long long searchMicros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - searchStart).count();
+            cout << "  Found " << results.size() << " restaurants in " << searchMicros << " us" << endl;
+            
+            string json = "{\"status\":\"success\",\"restaurants\":[";
+            for (size_t i = 0; i < results.size(); i++) {
+                appendRestaurantJSON(json, results[i]);
+                if (i < results.size() - 1) json += ",";
+            }
+            json += "],\"count\":" + to_string(results.size()) + ",\"elapsedUs\":" + to_string(searchMicros) + "}";
+            
+            return json;
+        }
+        
+        else if (action == "STATS") {
+            string userID;
+            ss >> userID;
+            
+            cout << "\n STATS:" << endl;
+            cout << "  User: " << userID << endl;
+            
+            auto statsStart = chrono::steady_clock::now();
+            KeyStats<float> ratingStats = storage->getFieldStats(userID, SORT_BY_RATING);
+            KeyStats<float> priceStats = storage->getFieldStats(userID, SORT_BY_PRICE);
+            vector<GroupStats> cuisineStats = storage->getCuisineStats(userID);
+            vector<GroupStats> locationStats = storage->getLocationStats(userID);
+            long long statsMicros = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - statsStart).count();
+            cout << "  " << cuisineStats.size() << " cuisines, " << locationStats.size() << " locations in " << statsMicros << " us" << endl;
+            
+            string json = "{\"status\":\"success\",\"total\":" + to_string(storage->getRestaurantCount(userID));
+            json += ",\"rating\":";
+            appendStatsJSON(json, ratingStats);
+            json += ",\"price\":";
+            appendStatsJSON(json, priceStats);
+            json += ",\"cuisines\":";
+            appendGroupStatsJSON(json, cuisineStats);
+            json += ",\"locations\":";
+            appendGroupStatsJSON(json, locationStats);
+            json += ",\"elapsedUs\":" + to_string(statsMicros) + "}";
             
             return json;
         }
@@ -514,7 +655,7 @@ string handleCommand(const string& command) {
 }
 
 void handleClient(SOCKET clientSocket) {
-    char buffer[4096];
+    char buffer[65536];
     
     while (true) {
         memset(buffer, 0, sizeof(buffer));
@@ -548,7 +689,8 @@ int main() {
     
     userManager = new UserManager();
     alertSystem = new AlertSystem();
-    recommendationSystem = new RecommendationSystem(userManager);
+    storage = new StorageEngine();
+    recommendationSystem = new RecommendationSystem(userManager, storage);
     
     SOCKET serverSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
     if (serverSocket == INVALID_SOCKET) {
@@ -604,6 +746,7 @@ int main() {
     delete userManager;
     delete alertSystem;
     delete recommendationSystem;
+    delete storage;
     
     return 0;
 }
\ No newline at end of file
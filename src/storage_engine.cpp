@@ -0,0 +1,152 @@
+#include "../include/storage_engine.h"
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+
+using namespace std;
+
+static string createParentDirectory(const string& filepath) {
+    error_code ec;
+    filesystem::path parent = filesystem::path(filepath).parent_path();
+    if (!parent.empty()) {
+        filesystem::create_directories(parent, ec);
+    }
+    return filepath;
+}
+
+StorageEngine::StorageEngine(const string& filepath, StorageMode mode)
+    : db(createParentDirectory(filepath), mode) {
+    db.setDurability(DURABILITY_BATCH);
+}
+
+void StorageEngine::stripTenant(Restaurant& r) {
+    r.restaurantId = string(localId(r.restaurantId));
+}
+
+void StorageEngine::stripTenant(vector<Restaurant>& restaurants) {
+    for (auto& r : restaurants) {
+        stripTenant(r);
+    }
+}
+
+void StorageEngine::stripTenant(vector<RestaurantView>& views) {
+    for (auto& view : views) {
+        view.restaurantId = localId(view.restaurantId);
+    }
+}
+
+string StorageEngine::addRestaurant(const string& userID, const string& name, const string& location, const vector<string>& cuisineTypes, float rating, float avgPrice, const vector<Dish>& dishes, const string& notes) {
+    string key = db.addRestaurant(name, location, cuisineTypes, rating, avgPrice, dishes, notes, userID);
+    return string(localId(key));
+}
+
+vector<string> StorageEngine::addRestaurants(const string& userID, const vector<Restaurant>& batch, bool sync) {
+    vector<string> ids = db.addRestaurants(batch, sync, userID);
+    for (auto& id : ids) {
+        id = string(localId(id));
+    }
+    return ids;
+}
+
+bool StorageEngine::updateRestaurant(const string& userID, const Restaurant& r) {
+    Restaurant stored = r;
+    stored.restaurantId = tenantKey(userID, r.restaurantId);
+    return db.updateRestaurant(stored);
+}
+
+bool StorageEngine::deleteRestaurant(const string& userID, const string& id) {
+    return db.deleteRestaurant(tenantKey(userID, id));
+}
+
+Restaurant StorageEngine::getRestaurant(const string& userID, const string& id) {
+    Restaurant r = db.getRestaurant(tenantKey(userID, id));
+    stripTenant(r);
+    return r;
+}
+
+vector<Restaurant> StorageEngine::query(const string& userID, const RestaurantQuery& q) {
+    RestaurantQuery scoped = q;
+    scoped.tenant = userID;
+    vector<Restaurant> restaurants = db.query(scoped);
+    stripTenant(restaurants);
+    return restaurants;
+}
+
+vector<RestaurantView> StorageEngine::queryViews(const string& userID, const RestaurantQuery& q) {
+    RestaurantQuery scoped = q;
+    scoped.tenant = userID;
+    vector<RestaurantView> views = db.queryViews(scoped);
+    stripTenant(views);
+    return views;
+}
+
+vector<Restaurant> StorageEngine::getUserRestaurants(const string& userID) {
+    return query(userID, RestaurantQuery());
+}
+
+RestaurantPage StorageEngine::getRestaurantPage(const string& userID, const string& cursor, int limit) {
+    RestaurantPage page = db.getRestaurantPage(cursor, limit, userID);
+    stripTenant(page.restaurants);
+    return page;
+}
+
+int StorageEngine::getRestaurantCount(const string& userID) {
+    return db.getTenantRestaurantCount(userID);
+}
+
+KeyStats<float> StorageEngine::getFieldStats(const string& userID, SortField field) {
+    return db.getTenantFieldStats(userID, field);
+}
+
+vector<GroupStats> StorageEngine::getCuisineStats(const string& userID) {
+    return db.getTenantCuisineStats(userID);
+}
+
+vector<GroupStats> StorageEngine::getLocationStats(const string& userID) {
+    return db.getTenantLocationStats(userID);
+}
+
+// The per-user file is only read: opening it as a DiskDatabase would migrate it and leave index files behind.
+int StorageEngine::importUserFile(const string& userID, const string& path) {
+    vector<Restaurant> restaurants = readRestaurantFile(path);
+    
+    int imported = db.importRestaurants(restaurants, userID);
+    cout << "Imported " << imported << " restaurants for " << userID << " from " << path << endl;
+    return imported;
+}
+
+// Per-user files are named user_<username>.dat, which is also the owner's userID.
+int StorageEngine::importUserDirectory(const string& directory) {
+    error_code ec;
+    vector<filesystem::path> files;
+    for (const auto& entry : filesystem::directory_iterator(directory, ec)) {
+        string name = entry.path().filename().string();
+        if (entry.is_regular_file() && entry.path().extension() == ".dat" && name.compare(0, 5, "user_") == 0) {
+            files.push_back(entry.path());
+        }
+    }
+    
+    if (ec) {
+        cerr << "Error. can not read " << directory << ": " << ec.message() << endl;
+        return 0;
+    }
+    
+    sort(files.begin(), files.end());
+    
+    int total = 0;
+    for (const auto& file : files) {
+        total += importUserFile(file.stem().string(), file.string());
+    }
+    
+    db.checkpointIndexes();
+    cout << "Migrated " << total << " restaurants from " << files.size() << " user files" << endl;
+    return total;
+}
+
+vector<string> StorageEngine::getUsers() {
+    return db.getTenants();
+}
+
+DiskDatabase& StorageEngine::getDatabase() {
+    return db;
+}
@@ -71,10 +71,10 @@ User* UserManager::getUser(const string& userID) {
     return (it != users.end()) ? &it->second : nullptr;
 }
 
-void UserManager::updateRestaurantCount(const string& userID) {
+void UserManager::updateRestaurantCount(const string& userID, int added) {
     auto it = users.find(userID);
     if (it != users.end()) {
-        it->second.totalRestaurants++;
+        it->second.totalRestaurants += added;
         saveUsers();
     }
 }
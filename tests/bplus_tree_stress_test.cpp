@@ -0,0 +1,166 @@
+#include "../include/btree.h"
+#include <map>
+#include <random>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+// Random inserts, removes and updates on BPlusTree, checked against std::multimap after every few hundred steps.
+// Keys repeat heavily and some values repeat too, so duplicate keys and rebalancing are both exercised.
+// The tree stores each (key, value) pair once, so inserting a pair it already holds leaves the multimap alone.
+
+static int failures = 0;
+
+static void expect(bool condition, const char* what, int degree, int step) {
+    if (!condition) {
+        failures++;
+        printf("FAIL degree %d step %d: %s\n", degree, step, what);
+    }
+}
+
+static float randomKey(mt19937& rng) {
+    return (rng() % 50) / 2.0f;
+}
+
+static bool containsEntry(const multimap<float, long long>& reference, float key, long long value) {
+    auto entries = reference.equal_range(key);
+    for (auto it = entries.first; it != entries.second; ++it) {
+        if (it->second == value) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static vector<pair<float, long long>> sortedEntries(const multimap<float, long long>& reference) {
+    vector<pair<float, long long>> entries(reference.begin(), reference.end());
+    sort(entries.begin(), entries.end());
+    return entries;
+}
+
+template <int T>
+static void compare(BPlusTree<float, long long, T>& tree, const multimap<float, long long>& reference, int step) {
+    vector<pair<float, long long>> want = sortedEntries(reference);
+    expect(tree.getAllPairs() == want, "getAllPairs differs from multimap", T, step);
+    
+    vector<pair<float, long long>> descending;
+    tree.forEachDescending([&](float key, long long value) {
+        descending.push_back(make_pair(key, value));
+        return true;
+    });
+    reverse(descending.begin(), descending.end());
+    expect(descending == want, "forEachDescending differs from multimap", T, step);
+    
+    KeyStats<float> stats = tree.getStats();
+    expect(stats.count == (int)reference.size(), "getStats count", T, step);
+    if (!reference.empty()) {
+        expect(stats.min == reference.begin()->first && stats.max == reference.rbegin()->first, "getStats min/max", T, step);
+    }
+    
+    for (float low : {-1.0f, 0.0f, 3.0f, 7.25f, 24.5f}) {
+        for (float high : {0.0f, 7.5f, 12.0f, 30.0f}) {
+            vector<long long> expected;
+            KeyStats<float> expectedStats;
+            for (const auto& entry : want) {
+                if (entry.first >= low && entry.first <= high) {
+                    expected.push_back(entry.second);
+                    expectedStats.add(entry.first);
+                }
+            }
+            expect(tree.searchRange(low, high) == expected, "searchRange", T, step);
+    
+            KeyStats<float> range = tree.rangeStats(low, high);
+            expect(range.count == expectedStats.count && fabs(range.sum - expectedStats.sum) < 1e-2, "rangeStats", T, step);
+        }
+    }
+    
+    for (int k = -1; k < 51; k++) {
+        float key = k / 2.0f;
+        long long* found = tree.search(key);
+        auto entries = reference.equal_range(key);
+        bool present = entries.first != entries.second;
+        expect((found != nullptr) == present, "search presence", T, step);
+        if (found) {
+            bool matches = false;
+            for (auto it = entries.first; it != entries.second; ++it) {
+                matches = matches || it->second == *found;
+            }
+            expect(matches, "search returned a value not stored under the key", T, step);
+        }
+    }
+    
+    // Every node but the root is at least half full, so underfull nodes left by a missed merge show up here.
+    TreeMemoryStats memory = tree.getMemoryStats();
+    int maxLeaves = (int)reference.size() / (T - 1) + 1;
+    expect(memory.liveNodes() <= 2 * maxLeaves, "more nodes than the entries can fill", T, step);
+}
+
+template <int T>
+static void stress(int steps) {
+    mt19937 rng(T * 7919);
+    BPlusTree<float, long long, T> tree;
+    multimap<float, long long> reference;
+    long long nextValue = 0;
+    
+    for (int step = 0; step < steps; step++) {
+        int op = rng() % 10;
+        if (op < 5 || reference.empty()) {
+            float key = randomKey(rng);
+            long long value = (rng() % 8 == 0 && !reference.empty()) ? reference.begin()->second : nextValue++;
+            tree.insert(key, value);
+            if (!containsEntry(reference, key, value)) {
+                reference.insert(make_pair(key, value));
+            }
+        } else if (op < 8) {
+            auto it = reference.begin();
+            advance(it, rng() % reference.size());
+            expect(tree.remove(it->first, it->second), "remove of a stored entry failed", T, step);
+            reference.erase(it);
+        } else if (op < 9) {
+            auto it = reference.begin();
+            advance(it, rng() % reference.size());
+            long long value = nextValue++;
+            expect(tree.update(it->first, it->second, value), "update of a stored entry failed", T, step);
+            reference.insert(make_pair(it->first, value));
+            reference.erase(it);
+        } else {
+            expect(!tree.remove(randomKey(rng), -1), "remove of a missing entry succeeded", T, step);
+            expect(!tree.update(1.0f, -5, 3), "update of a missing entry succeeded", T, step);
+        }
+    
+        if (step % 499 == 0 || reference.size() < 5) {
+            compare(tree, reference, step);
+        }
+    }
+    
+    // Draining the tree walks every merge path back down to a single leaf.
+    int step = steps;
+    while (!reference.empty()) {
+        auto it = reference.begin();
+        advance(it, rng() % reference.size());
+        expect(tree.remove(it->first, it->second), "remove while draining failed", T, step);
+        reference.erase(it);
+        if (reference.size() % 250 == 0) {
+            compare(tree, reference, step);
+        }
+        step++;
+    }
+    expect(tree.getMemoryStats().liveNodes() == 1, "drained tree is not a single leaf", T, step);
+    
+    printf("degree %d: %d steps\n", T, steps);
+}
+
+int main() {
+    stress<2>(60000);
+    stress<3>(60000);
+    stress<5>(60000);
+    stress<BPLUS_DEGREE>(60000);
+    
+    if (failures > 0) {
+        printf("%d checks failed\n", failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
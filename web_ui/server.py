@@ -161,6 +161,10 @@ class FoodSpotHandler(SimpleHTTPRequestHandler):
             return self.handle_search_rating(params)
         elif path == 'search_price':
             return self.handle_search_price(params)
+        elif path == 'query':
+            return self.handle_query(params)
+        elif path == 'stats':
+            return self.handle_stats(params)
         else:
             return {"status": "error", "message": "Unknown API endpoint"}
 
@@ -203,7 +207,12 @@ class FoodSpotHandler(SimpleHTTPRequestHandler):
     
     def handle_get_restaurants(self, params):
         user_id = params.get('userID', '')
+        cursor = params.get('cursor', '')
+        limit = params.get('limit', '')
+        
         cmd = f"GET_RESTAURANTS {user_id}"
+        if cursor != '' and limit != '':
+            cmd += f" {cursor} {limit}"
         return self.cpp_backend.send_command(cmd)
     
     def handle_get_friends(self, params):
@@ -277,6 +286,31 @@ class FoodSpotHandler(SimpleHTTPRequestHandler):
         print(f" Search price command: {cmd}")
         return self.cpp_backend.send_command(cmd)
 
+    def handle_query(self, params):
+        user_id = params.get('userID', '')
+        cuisine = params.get('cuisine', '').replace(' ', '_') or '*'
+        location = params.get('location', '').replace(' ', '_') or '*'
+        min_rating = params.get('minRating', '*') or '*'
+        max_rating = params.get('maxRating', '*') or '*'
+        min_price = params.get('minPrice', '*') or '*'
+        max_price = params.get('maxPrice', '*') or '*'
+        
+        if not user_id:
+            return {"status": "error", "message": "User ID required"}
+        
+        cmd = f"QUERY {user_id} {cuisine} {location} {min_rating} {max_rating} {min_price} {max_price}"
+        print(f" Query command: {cmd}")
+        return self.cpp_backend.send_command(cmd)
+
+    def handle_stats(self, params):
+        user_id = params.get('userID', '')
+        
+        if not user_id:
+            return {"status": "error", "message": "User ID required"}
+        
+        cmd = f"STATS {user_id}"
+        return self.cpp_backend.send_command(cmd)
+
 def start_server(port=5000):
     os.chdir(os.path.dirname(os.path.abspath(__file__)))
     